@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L
+#include "autotune.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_LINE 512
+#define AUTOTUNE_GATES 4     /* gate della sequenza usati nel benchmark */
+#define AUTOTUNE_REPS 3      /* ripetizioni per configurazione (si tiene la migliore) */
+#define SHAPE_LEN 64         /* lunghezza massima della forma del circuito (chiave) */
+
+
+/* CHIAVE DI TUNING */
+
+/**
+ * Forma del circuito, usata come chiave di tuning: numero di gate distinti
+ * usati nella sequenza, quanti sono densi, quanti trasformate e quanti
+ * locali per dimensione del supporto (0..GATE_LOCAL_MAX_QUBITS qubit).
+ * Usa solo informazioni già note dopo il parsing, senza leggere le
+ * matrici: ad esempio "g5-d1-t0-k0.3.1.0.0".
+ */
+static void circuit_shape(const Circuit *c, char *buf, size_t size) {
+    size_t dense = 0, transforms = 0, used_count = 0;
+    size_t local[GATE_LOCAL_MAX_QUBITS + 1] = {0};
+
+    char *used = calloc(c->gate_count + 1, 1);
+    if (!used) {
+        perror("Errore calloc autotune");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t s = 0; s < c->sequence_len; s++) used[c->sequence[s]] = 1;
+
+    for (size_t g = 0; g < c->gate_count; g++) {
+        if (!used[g]) continue;
+        const Gate *gate = &c->gates[g];
+        used_count++;
+        if (gate->transform != TRANSFORM_NONE) transforms++;
+        else if (gate->analyzed && gate->local.data) local[gate->support_len]++;
+        else dense++;
+    }
+    free(used);
+
+    int len = snprintf(buf, size, "g%zu-d%zu-t%zu-k", used_count, dense, transforms);
+    for (unsigned int k = 0; k <= GATE_LOCAL_MAX_QUBITS && len > 0 && (size_t)len < size; k++)
+        len += snprintf(buf + len, size - len, k ? ".%zu" : "%zu", local[k]);
+}
+
+static void tune_file_path(char *buf, size_t size) {
+    const char *env = getenv(AUTOTUNE_ENV);
+    const char *home = getenv("HOME");
+    if (env && *env)
+        snprintf(buf, size, "%s", env);
+    else if (home && *home)
+        snprintf(buf, size, "%s/%s", home, AUTOTUNE_FILE);
+    else
+        snprintf(buf, size, "%s", AUTOTUNE_FILE);
+}
+
+static const char *kernel_name(KernelKind k) {
+    if (k == KERNEL_LOCAL) return "local";
+    return k == KERNEL_SPARSE ? "sparse" : "dense";
+}
+
+
+/* LETTURA / SCRITTURA DEL FILE DI TUNING */
+
+/**
+ * Cerca la configurazione per (host, qubits, shape) nel file di tuning.
+ * Formato di una riga: "<host> <qubits> <forma> <thread> <chunk> <kernel>".
+ * Output: 1 se trovata, 0 altrimenti
+ */
+static int load_config(const char *path, const char *host, unsigned int qubits,
+                       const char *shape, ExecConfig *cfg) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    char line[MAX_LINE];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), fp)) {
+        char h[256], k[SHAPE_LEN], kernel[16];
+        unsigned int q;
+        size_t threads, chunk;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%255s %u %63s %zu %zu %15s", h, &q, k, &threads, &chunk, kernel) != 6)
+            continue;
+        if (strcmp(h, host) != 0 || q != qubits || strcmp(k, shape) != 0 || threads == 0) continue;
+
+        cfg->n_threads = threads;
+        cfg->chunk = chunk;
+        if (strcmp(kernel, "local") == 0)
+            cfg->kernel = KERNEL_LOCAL;
+        else
+            cfg->kernel = strcmp(kernel, "sparse") == 0 ? KERNEL_SPARSE : KERNEL_DENSE;
+        found = 1;
+    }
+    fclose(fp);
+    return found;
+}
+
+/**
+ * Salva la configurazione nel file di tuning, sostituendo un'eventuale
+ * riga con la stessa chiave. La scrittura avviene su un file temporaneo
+ * rinominato al termine, così un'interruzione non corrompe il file.
+ */
+static void save_config(const char *path, const char *host, unsigned int qubits,
+                        const char *shape, const ExecConfig *cfg) {
+    char tmp_path[1024 + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        fprintf(stderr, "Autotune: cannot write %s\n", tmp_path);
+        return;
+    }
+
+    FILE *in = fopen(path, "r");
+    if (in) {
+        char line[MAX_LINE];
+        while (fgets(line, sizeof(line), in)) {
+            char h[256], k[SHAPE_LEN];
+            unsigned int q;
+            if (line[0] != '#' && sscanf(line, "%255s %u %63s", h, &q, k) == 3 &&
+                strcmp(h, host) == 0 && q == qubits && strcmp(k, shape) == 0)
+                continue;
+            fputs(line, out);
+        }
+        fclose(in);
+    } else {
+        fprintf(out, "# host qubits forma thread chunk kernel\n");
+    }
+
+    fprintf(out, "%s %u %s %zu %zu %s\n", host, qubits, shape,
+            cfg->n_threads, cfg->chunk, kernel_name(cfg->kernel));
+    fclose(out);
+
+    if (rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Autotune: cannot update %s\n", path);
+        remove(tmp_path);
+    }
+}
+
+
+/* MICRO-BENCHMARK */
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Misura il tempo migliore su AUTOTUNE_REPS esecuzioni della sequenza
+ * ridotta 'bench', ripartendo ogni volta dallo stato 'initial'.
+ */
+static double bench_config(Circuit *bench, const ComplexVector *initial, ThreadPool *pool,
+                           size_t chunk, KernelKind kernel, ComplexVector *scratch) {
+    double best = -1.0;
+
+    // La prima esecuzione serve da riscaldamento (cache, matrici CSR)
+    for (int r = 0; r <= AUTOTUNE_REPS; r++) {
+        memcpy(bench->state.data, initial->data, bench->dim * sizeof(Complex));
+        double t0 = now_seconds();
+        circuit_execute_config(bench, pool, chunk, kernel, scratch);
+        double t = now_seconds() - t0;
+        if (r > 0 && (best < 0 || t < best)) best = t;
+    }
+    return best;
+}
+
+/**
+ * Prova tutte le combinazioni di thread (potenze di 2 fino al numero di
+ * core), dimensione dei blocchi e kernel, e restituisce la più veloce.
+ */
+static void measure_config(Circuit *c, ExecConfig *best) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = ncpu > 0 ? (size_t)ncpu : 1;
+    if (max_threads > c->dim) max_threads = c->dim;
+
+    // Circuito di benchmark: stessi gate, sequenza ridotta, stato separato
+    Circuit bench = *c;
+    bench.sequence_len = c->sequence_len < AUTOTUNE_GATES ? c->sequence_len : AUTOTUNE_GATES;
+    bench.state = alloc_complex_vector(c->dim);
+    ComplexVector scratch = alloc_complex_vector(c->dim);
+
+    best->n_threads = 1;
+    best->chunk = 0;
+    best->kernel = KERNEL_DENSE;
+    double best_time = -1.0;
+
+    size_t threads = 1;
+    for (;;) {
+        ThreadPool pool;
+        threadpool_init(&pool, threads);
+
+        // Blocchi: uno per thread, oppure 4 o 16 blocchi per thread
+        size_t chunks[3];
+        chunks[0] = 0;
+        chunks[1] = c->dim / (4 * threads);
+        chunks[2] = c->dim / (16 * threads);
+        size_t n_chunks = threads == 1 ? 1 : 3;
+
+        for (size_t ci = 0; ci < n_chunks; ci++) {
+            if (ci > 0 && chunks[ci] == 0) continue;
+            for (int k = KERNEL_DENSE; k <= KERNEL_LOCAL; k++) {
+                double t = bench_config(&bench, &c->state, &pool, chunks[ci],
+                                        (KernelKind)k, &scratch);
+                if (best_time < 0 || t < best_time) {
+                    best_time = t;
+                    best->n_threads = threads;
+                    best->chunk = chunks[ci];
+                    best->kernel = (KernelKind)k;
+                }
+            }
+        }
+        threadpool_free(&pool);
+
+        if (threads == max_threads) break;
+        threads = (threads * 2 > max_threads) ? max_threads : threads * 2;
+    }
+
+    free_complex_vector(&bench.state);
+    free_complex_vector(&scratch);
+}
+
+
+/* INTERFACCIA PUBBLICA */
+
+void autotune_config(Circuit *c, ExecConfig *cfg) {
+    char host[256];
+    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+
+    char path[1024];
+    tune_file_path(path, sizeof(path));
+    char shape[SHAPE_LEN];
+    circuit_shape(c, shape, sizeof(shape));
+
+    if (load_config(path, host, c->n_qubits, shape, cfg)) return;
+
+    if (c->sequence_len == 0) {
+        cfg->n_threads = 1;
+        cfg->chunk = 0;
+        cfg->kernel = KERNEL_DENSE;
+        return;
+    }
+
+    measure_config(c, cfg);
+    fprintf(stderr, "Autotune: %u qubit, forma %s -> %zu thread, chunk %zu, kernel %s (%s)\n",
+            c->n_qubits, shape, cfg->n_threads, cfg->chunk, kernel_name(cfg->kernel), path);
+    save_config(path, host, c->n_qubits, shape, cfg);
+}
@@ -0,0 +1,28 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "circuit.h"
+
+/* Variabile d'ambiente che sostituisce il percorso predefinito del file di tuning */
+#define AUTOTUNE_ENV "QSIM_TUNE_FILE"
+
+/* File di tuning predefinito, relativo alla home dell'utente */
+#define AUTOTUNE_FILE ".quantum_sim_tune"
+
+/**
+ * Sceglie la configurazione di esecuzione (thread, dimensione dei blocchi,
+ * kernel) per il circuito indicato (usato con -t auto).
+ *
+ * La configurazione viene cercata nel file di tuning con chiave
+ * (host, numero di qubit, forma del circuito: gate distinti usati e, per
+ * ognuno, se è denso, una trasformata o locale e su quanti qubit), calcolata
+ * senza leggere le matrici; se assente, le
+ * strategie disponibili vengono misurate con un micro-benchmark su alcuni
+ * gate della sequenza e la vincente viene salvata nel file.
+ * Lo stato del circuito non viene modificato.
+ *
+ * Input: c (circuito già caricato), cfg (output)
+ */
+void autotune_config(Circuit *c, ExecConfig *cfg);
+
+#endif
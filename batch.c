@@ -0,0 +1,330 @@
+#define _POSIX_C_SOURCE 200809L
+#include "batch.h"
+#include "circuit.h"
+#include "initparser.h"
+#include "circparser.h"
+#include "repeat.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#define MAX_LINE 4096
+
+
+/* STRUTTURE DEL BATCH */
+
+/**
+ * Un job del manifest: coppia (init, circ) e file di output.
+ */
+typedef struct {
+    char *init_file;
+    char *circ_file;
+    char *out_file;
+    unsigned int n_qubits;
+    int failed;
+} BatchJob;
+
+/**
+ * Coda di job di un worker. Il proprietario estrae dalla coda (tail), dove
+ * si trovano i job più costosi; gli altri worker rubano dalla testa (head),
+ * prendendo i job più leggeri e bilanciando così la parte finale del batch.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t *items;
+    size_t head;
+    size_t tail;
+} JobDeque;
+
+typedef struct {
+    BatchJob *jobs;
+    JobDeque *deques;
+    size_t n_deques;
+    ComplexVector *scratch;      /* buffer ausiliario per ogni worker */
+} BatchContext;
+
+
+/* MANIFEST */
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    if (*s == 0) return s;
+    char *end = s + strlen(s) - 1;
+    while (end > s && isspace((unsigned char)*end)) *end-- = 0;
+    return s;
+}
+
+/**
+ * Legge il manifest e restituisce l'array dei job in *out.
+ * Output: 0 in caso di successo, -1 in caso di errore
+ */
+static int read_manifest(const char *manifest, BatchJob **out_jobs, size_t *count) {
+    FILE *fp = fopen(manifest, "r");
+    if (!fp) {
+        fprintf(stderr, "Batch error: cannot open manifest %s\n", manifest);
+        return -1;
+    }
+
+    BatchJob *jobs = NULL;
+    size_t n = 0;
+    char line[MAX_LINE];
+    size_t lineno = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *l = trim(line);
+        if (*l == '\0' || *l == '%') continue;
+
+        char *save = NULL;
+        char *init = strtok_r(l, " \t", &save);
+        char *circ = strtok_r(NULL, " \t", &save);
+        char *out = strtok_r(NULL, " \t", &save);
+        if (!init || !circ) {
+            fprintf(stderr, "Batch error: %s:%zu: expected '<init> <circ> [out]'\n",
+                    manifest, lineno);
+            fclose(fp);
+            for (size_t i = 0; i < n; i++) {
+                free(jobs[i].init_file); free(jobs[i].circ_file); free(jobs[i].out_file);
+            }
+            free(jobs);
+            return -1;
+        }
+
+        jobs = realloc(jobs, (n + 1) * sizeof(BatchJob));
+        if (!jobs) {
+            perror("Errore realloc jobs");
+            exit(EXIT_FAILURE);
+        }
+
+        BatchJob *job = &jobs[n];
+        job->init_file = strdup(init);
+        job->circ_file = strdup(circ);
+        if (out) {
+            job->out_file = strdup(out);
+        } else {
+            // Output predefinito: <manifest>.<indice>.out
+            size_t len = strlen(manifest) + 32;
+            job->out_file = malloc(len);
+            snprintf(job->out_file, len, "%s.%zu.out", manifest, n);
+        }
+        job->n_qubits = 0;
+        job->failed = 0;
+        n++;
+    }
+    fclose(fp);
+
+    *out_jobs = jobs;
+    *count = n;
+    return 0;
+}
+
+
+/* ESECUZIONE DI UN JOB */
+
+/**
+ * Esegue un job e scrive lo stato finale nel suo file di output.
+ * pool NULL: esecuzione seriale nel thread corrente.
+ */
+static void run_job(BatchJob *job, ThreadPool *pool, ComplexVector *scratch) {
+    // Un file non valido fa fallire solo questo job
+    Circuit c;
+    if (parse_init_file(job->init_file, &c) != 0) {
+        fprintf(stderr, "Batch error: invalid init file %s\n", job->init_file);
+        job->failed = 1;
+        return;
+    }
+    if (parse_circ_file(job->circ_file, &c) != 0 || circuit_expand_repeats(&c, pool) != 0) {
+        fprintf(stderr, "Batch error: invalid circuit file %s\n", job->circ_file);
+        job->failed = 1;
+        circuit_free(&c);
+        return;
+    }
+
+    // Lo stato solo sparso non è supportato dagli esecutori densi dei job
+    if (!c.state.data) {
+        fprintf(stderr, "Batch error: %s: too many qubits for a dense state\n", job->init_file);
+        job->failed = 1;
+        circuit_free(&c);
+        return;
+    }
+
+    // Il buffer ausiliario del worker viene riallocato solo se cambia dimensione
+    if (scratch->size != c.dim) {
+        free_complex_vector(scratch);
+        *scratch = alloc_complex_vector(c.dim);
+    }
+
+    if (pool)
+        circuit_execute_pool(&c, pool, scratch);
+    else
+        circuit_execute_serial(&c, scratch);
+
+    FILE *out = fopen(job->out_file, "w");
+    if (out) {
+        circuit_fprint_state(out, &c);
+        fclose(out);
+    } else {
+        fprintf(stderr, "Batch error: cannot write %s\n", job->out_file);
+        job->failed = 1;
+    }
+
+    circuit_free(&c);
+}
+
+
+/* SCHEDULER CON WORK-STEALING */
+
+static int deque_pop(JobDeque *d, size_t *job) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *job = d->items[--d->tail];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static int deque_steal(JobDeque *d, size_t *job) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *job = d->items[d->head++];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+/**
+ * Ciclo di un worker: svuota la propria coda, poi ruba dalle altre.
+ * Termina quando tutte le code sono vuote (non vengono creati nuovi job).
+ */
+static void batch_worker(void *arg, size_t begin, size_t end, size_t worker) {
+    BatchContext *ctx = (BatchContext *)arg;
+
+    for (size_t own = begin; own < end; own++) {
+        size_t job;
+        for (;;) {
+            if (deque_pop(&ctx->deques[own], &job)) {
+                run_job(&ctx->jobs[job], NULL, &ctx->scratch[worker]);
+                continue;
+            }
+
+            int stolen = 0;
+            for (size_t k = 1; k < ctx->n_deques && !stolen; k++) {
+                if (deque_steal(&ctx->deques[(own + k) % ctx->n_deques], &job))
+                    stolen = 1;
+            }
+            if (!stolen) break;
+            run_job(&ctx->jobs[job], NULL, &ctx->scratch[worker]);
+        }
+    }
+}
+
+/* Ordina gli indici dei job per numero di qubit decrescente (insertion sort stabile) */
+static void sort_by_cost(size_t *idx, size_t n, const BatchJob *jobs) {
+    for (size_t i = 1; i < n; i++) {
+        size_t v = idx[i];
+        size_t j = i;
+        while (j > 0 && jobs[idx[j - 1]].n_qubits < jobs[v].n_qubits) {
+            idx[j] = idx[j - 1];
+            j--;
+        }
+        idx[j] = v;
+    }
+}
+
+
+/* ESECUZIONE DEL BATCH */
+
+int batch_run(const char *manifest, size_t n_threads) {
+    size_t n_jobs = 0;
+    BatchJob *jobs = NULL;
+    if (read_manifest(manifest, &jobs, &n_jobs) != 0) return EXIT_FAILURE;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    // Classificazione dei job in base al numero di qubit
+    size_t *small = malloc((n_jobs + 1) * sizeof(size_t));
+    size_t *large = malloc((n_jobs + 1) * sizeof(size_t));
+    size_t n_small = 0, n_large = 0;
+    for (size_t i = 0; i < n_jobs; i++) {
+        if (parse_init_qubits(jobs[i].init_file, &jobs[i].n_qubits) != 0) {
+            fprintf(stderr, "Batch error: cannot read #qubits from %s\n", jobs[i].init_file);
+            jobs[i].failed = 1;
+            continue;
+        }
+        if (jobs[i].n_qubits >= BATCH_LARGE_QUBITS) large[n_large++] = i;
+        else small[n_small++] = i;
+    }
+
+    ThreadPool pool;
+    threadpool_init(&pool, n_threads);
+
+    BatchContext ctx;
+    ctx.jobs = jobs;
+    ctx.n_deques = pool.n_threads;
+    ctx.deques = malloc(ctx.n_deques * sizeof(JobDeque));
+    ctx.scratch = calloc(ctx.n_deques, sizeof(ComplexVector));
+    if (!small || !large || !ctx.deques || !ctx.scratch) {
+        perror("Errore malloc batch");
+        exit(EXIT_FAILURE);
+    }
+
+    // Distribuzione round-robin dei job piccoli, dal più costoso
+    sort_by_cost(small, n_small, jobs);
+    for (size_t d = 0; d < ctx.n_deques; d++) {
+        pthread_mutex_init(&ctx.deques[d].lock, NULL);
+        ctx.deques[d].items = malloc((n_small / ctx.n_deques + 1) * sizeof(size_t));
+        ctx.deques[d].head = 0;
+        ctx.deques[d].tail = 0;
+    }
+    // Il proprietario estrae dalla coda: si inserisce in ordine inverso
+    for (size_t i = n_small; i-- > 0;) {
+        JobDeque *d = &ctx.deques[i % ctx.n_deques];
+        d->items[d->tail++] = small[i];
+    }
+
+    // Fase 1: job piccoli concorrenti, ciascuno seriale
+    threadpool_run(&pool, batch_worker, &ctx, ctx.n_deques, 1);
+
+    // Fase 2: job grandi uno alla volta, con il gate suddiviso tra i thread
+    sort_by_cost(large, n_large, jobs);
+    for (size_t i = 0; i < n_large; i++)
+        run_job(&jobs[large[i]], &pool, &ctx.scratch[0]);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    size_t n_failed = 0;
+    for (size_t i = 0; i < n_jobs; i++)
+        if (jobs[i].failed) n_failed++;
+
+    fprintf(stderr, "Batch: %zu job (%zu piccoli, %zu grandi, %zu falliti) in %.3f s, %.1f job/s\n",
+            n_jobs, n_small, n_large, n_failed, secs, secs > 0 ? n_jobs / secs : 0.0);
+
+    for (size_t d = 0; d < ctx.n_deques; d++) {
+        pthread_mutex_destroy(&ctx.deques[d].lock);
+        free(ctx.deques[d].items);
+        free_complex_vector(&ctx.scratch[d]);
+    }
+    free(ctx.deques);
+    free(ctx.scratch);
+    threadpool_free(&pool);
+
+    for (size_t i = 0; i < n_jobs; i++) {
+        free(jobs[i].init_file);
+        free(jobs[i].circ_file);
+        free(jobs[i].out_file);
+    }
+    free(jobs);
+    free(small);
+    free(large);
+
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
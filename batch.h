@@ -0,0 +1,26 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+/* Numero di qubit da cui un job viene eseguito con parallelismo interno */
+#define BATCH_LARGE_QUBITS 8
+
+/**
+ * Modalità batch (--batch): esegue molti circuiti elencati in un manifest.
+ *
+ * Ogni riga del manifest contiene "<file_init> <file_circ> [file_output]";
+ * righe vuote e commenti (%) sono ignorati. Se il file di output non è
+ * indicato si usa "<manifest>.<indice>.out".
+ *
+ * I job piccoli (meno di BATCH_LARGE_QUBITS qubit) vengono eseguiti
+ * interamente in parallelo, un job per worker in modo seriale, su uno
+ * scheduler con work-stealing. I job grandi vengono poi eseguiti uno alla
+ * volta suddividendo ogni gate tra tutti i thread.
+ *
+ * Input: manifest (percorso), n_threads (numero di worker)
+ * Output: EXIT_SUCCESS se tutti i job sono andati a buon fine
+ */
+int batch_run(const char *manifest, size_t n_threads);
+
+#endif
@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include "circparser.h"
 #include "complex_matrix.h"
 #include <stdio.h>
@@ -7,11 +8,12 @@
 
 #define MAX_LINE 4096
 #define MAX_TOKENS 256
+#define MAX_REPEAT_DEPTH 32
 
 // Gestione centralizzata degli errori di parsing
-static void parse_error(const char *msg) {
+static int parse_error(const char *msg) {
     fprintf(stderr, "Circ parser error: %s\n", msg);
-    exit(EXIT_FAILURE);
+    return -1;
 }
 
 // Rimuove spazi bianchi iniziali e finali per pulire i token
@@ -37,6 +39,10 @@ static Complex parse_complex(const char *s) {
     buf[127] = '\0';
     char *p = trim(buf);
 
+    // Una virgola finale separa gli elementi ("0.5+i0.5,"): non fa parte del numero
+    size_t plen = strlen(p);
+    if (plen > 1 && p[plen - 1] == ',') p[plen - 1] = '\0';
+
     // Caso formato (reale, immaginario)
     char *comma = strchr(p, ',');
     if (comma) {
@@ -62,90 +68,393 @@ static Complex parse_complex(const char *s) {
     return z;
 }
 
-void parse_circ_file(const char *filename, Circuit *c) {
+// Cerca un gate per nome: restituisce il suo indice oppure gate_count
+static size_t find_gate(const Circuit *c, const char *name) {
+    size_t k;
+    for (k = 0; k < c->gate_count; k++) {
+        if (strcmp(c->gates[k].name, name) == 0) break;
+    }
+    return k;
+}
+
+/**
+ * Interpreta la direttiva #noise (dopo le definizioni dei gate):
+ *   #noise depolarizing <p>
+ *   #noise damping <gamma>
+ *   #noise kraus <K0> <K1> ...   (gate già definiti usati come operatori di Kraus)
+ */
+static int parse_noise(char *p, Circuit *c) {
+    char *save = NULL;
+    char *kind = strtok_r(p, " \t\n\r", &save);
+    if (!kind) return parse_error("Invalid #noise: missing channel");
+
+    NoiseChannel ch = {NOISE_DEPOLARIZING, 0.0, NULL, 0};
+
+    if (strcmp(kind, "depolarizing") == 0 || strcmp(kind, "damping") == 0) {
+        ch.kind = strcmp(kind, "depolarizing") == 0 ? NOISE_DEPOLARIZING : NOISE_DAMPING;
+        char *arg = strtok_r(NULL, " \t\n\r", &save);
+        char *end = NULL;
+        if (!arg) return parse_error("Invalid #noise: missing probability");
+        ch.param = strtod(arg, &end);
+        if (*end != '\0' || ch.param < 0.0 || ch.param > 1.0)
+            return parse_error("Invalid #noise: probability must be in [0, 1]");
+    }
+    else if (strcmp(kind, "kraus") == 0) {
+        ch.kind = NOISE_KRAUS;
+        ch.kraus = malloc(sizeof(size_t) * MAX_TOKENS);
+        if (!ch.kraus) return parse_error("Out of memory");
+        char *tok;
+        while ((tok = strtok_r(NULL, " \t\n\r", &save)) && ch.kraus_count < MAX_TOKENS) {
+            size_t k = find_gate(c, tok);
+            if (k == c->gate_count) {
+                free(ch.kraus);
+                return parse_error("Kraus operator not defined");
+            }
+            ch.kraus[ch.kraus_count++] = k;
+        }
+        if (ch.kraus_count == 0) {
+            free(ch.kraus);
+            return parse_error("Invalid #noise: kraus needs at least one operator");
+        }
+    }
+    else {
+        return parse_error("Invalid #noise: unknown channel");
+    }
+
+    circuit_add_noise(c, ch);
+    return 0;
+}
+
+/**
+ * Registra il gate e, se la matrice è una DFT (anche inversa o con i qubit
+ * in ordine invertito) o una Walsh-Hadamard, lo marca per il kernel veloce.
+ */
+static void add_gate(Circuit *c, const char *name, ComplexMatrix mat) {
+    circuit_add_gate(c, name, mat);
+    Gate *g = &c->gates[c->gate_count - 1];
+    g->transform = transform_detect(&g->matrix, &g->reverse_in, &g->reverse_out);
+}
+
+/* Differenza tra parentesi graffe aperte e chiuse nella stringa */
+static int brace_balance(const char *s) {
+    int depth = 0;
+    for (; *s; s++) {
+        if (*s == '{') depth++;
+        else if (*s == '}') depth--;
+    }
+    return depth;
+}
+
+/**
+ * Legge un'istruzione di sequenza a partire dalla riga corrente, aggiungendo
+ * le righe successive finché le parentesi graffe dei #repeat non sono bilanciate.
+ * Output: stringa allocata dinamicamente, NULL in caso di errore
+ */
+static char *read_statement(const char *first, FILE *fp) {
+    size_t len = strlen(first), cap = len + MAX_LINE;
+    char *text = malloc(cap);
+    if (!text) {
+        parse_error("Out of memory");
+        return NULL;
+    }
+    memcpy(text, first, len + 1);
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    while (brace_balance(text) > 0) {
+        if (getline(&line, &line_cap, fp) == -1) {
+            free(text);
+            free(line);
+            parse_error("Missing closing } in #repeat");
+            return NULL;
+        }
+        size_t n = strlen(line);
+        if (len + n + 2 > cap) {
+            cap = 2 * (len + n + 2);
+            char *grown = realloc(text, cap);
+            if (!grown) {
+                free(text);
+                free(line);
+                parse_error("Out of memory");
+                return NULL;
+            }
+            text = grown;
+        }
+        text[len++] = ' ';
+        memcpy(text + len, line, n + 1);
+        len += n;
+    }
+    free(line);
+    return text;
+}
+
+/**
+ * Accoda alla sequenza i gate dell'istruzione e registra i blocchi
+ * "#repeat <count> { ... }", anche annidati.
+ */
+static int parse_sequence(const char *text, Circuit *c) {
+    // Spazi attorno alle graffe, così "{H" e "X}" diventano token separati
+    char *spaced = malloc(3 * strlen(text) + 1);
+    if (!spaced) return parse_error("Out of memory");
+    size_t j = 0;
+    for (const char *p = text; *p; p++) {
+        if (*p == '{' || *p == '}') {
+            spaced[j++] = ' ';
+            spaced[j++] = *p;
+            spaced[j++] = ' ';
+        } else {
+            spaced[j++] = *p;
+        }
+    }
+    spaced[j] = '\0';
+
+    RepeatBlock stack[MAX_REPEAT_DEPTH];
+    size_t depth = 0;
+    int status = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(spaced, " \t\n\r", &save); tok && status == 0;
+         tok = strtok_r(NULL, " \t\n\r", &save)) {
+        if (strcmp(tok, "#repeat") == 0) {
+            char *count = strtok_r(NULL, " \t\n\r", &save);
+            char *open = strtok_r(NULL, " \t\n\r", &save);
+            char *end = NULL;
+            unsigned long long n = count ? strtoull(count, &end, 10) : 0;
+            if (!count || *end != '\0' || !open || strcmp(open, "{") != 0) {
+                status = parse_error("Invalid #repeat: expected '#repeat COUNT { ... }'");
+                break;
+            }
+            if (depth == MAX_REPEAT_DEPTH) {
+                status = parse_error("Invalid #repeat: nested too deeply");
+                break;
+            }
+            stack[depth].start = c->sequence_len;
+            stack[depth].count = (size_t)n;
+            depth++;
+        } else if (strcmp(tok, "}") == 0) {
+            if (depth == 0) {
+                status = parse_error("Unexpected } in sequence");
+                break;
+            }
+            RepeatBlock block = stack[--depth];
+            block.len = c->sequence_len - block.start;
+            circuit_add_repeat(c, block);
+        } else if (strcmp(tok, "{") == 0) {
+            status = parse_error("Unexpected { in sequence");
+        } else {
+            // Mappatura del nome del gate al suo indice interno
+            size_t k = find_gate(c, tok);
+            if (k == c->gate_count) status = parse_error("Gate not defined");
+            else circuit_append_sequence(c, &k, 1);
+        }
+    }
+    if (status == 0 && depth > 0) status = parse_error("Missing closing } in #repeat");
+    free(spaced);
+    return status;
+}
+
+/**
+ * Direttiva #define: matrice densa 2^n x 2^n oppure, nella forma
+ * "#define <nome> on <q0> <q1> ... [ ... ]", matrice 2^k x 2^k sui soli
+ * qubit indicati. La matrice può proseguire su più righe.
+ */
+static int parse_define(const char *l, FILE *fp, Circuit *c) {
+    char name[32];
+    if (sscanf(l, "#define %31s", name) != 1) return parse_error("Invalid gate name");
+
+    // Forma locale: #define <nome> on <q0> <q1> ... [ matrice 2^k x 2^k ]
+    unsigned int qubits[GATE_LOCAL_MAX_QUBITS];
+    unsigned int k = 0;
+    int local = 0;
+    const char *p = strstr(l + 7, name) + strlen(name);
+    while (isspace((unsigned char)*p)) p++;
+    if (strncmp(p, "on", 2) == 0 && isspace((unsigned char)p[2])) {
+        local = 1;
+        p += 2;
+        while (isspace((unsigned char)*p)) p++;
+        while (*p && *p != '[') {
+            char *end;
+            unsigned long q = strtoul(p, &end, 10);
+            if (end == p) return parse_error("Invalid #define: expected '#define NAME on q0 q1 ... [ ... ]'");
+            if (q >= c->n_qubits) return parse_error("Invalid #define: qubit out of range");
+            if (k == GATE_LOCAL_MAX_QUBITS) return parse_error("Invalid #define: too many qubits for a local gate");
+            for (unsigned int b = 0; b < k; b++)
+                if (qubits[b] == q) return parse_error("Invalid #define: repeated qubit");
+            qubits[k++] = (unsigned int)q;
+            p = end;
+            while (isspace((unsigned char)*p)) p++;
+        }
+        if (k == 0) return parse_error("Invalid #define: no qubits after 'on'");
+    } else if (c->n_qubits > CIRCUIT_DENSE_MAX_QUBITS) {
+        return parse_error("Dense #define on too many qubits: use '#define NAME on q0 q1 ... [ ... ]'");
+    }
+
+    const char *start = strchr(l, '[');
+    if (!start) return parse_error("Invalid matrix: missing '['");
+
+    size_t dim = local ? (size_t)1 << k : c->dim;
+    size_t buffer_size = dim * dim * 64 + MAX_LINE;
+    char *buffer = malloc(buffer_size); // Allocazione dinamica per sistemi grandi 
+    if (!buffer) return parse_error("Out of memory");
+    size_t used = strlen(start);
+    if (used + 1 >= buffer_size) {
+        free(buffer);
+        return parse_error("Matrix too long");
+    }
+    memcpy(buffer, start, used + 1);
+
+    // Accumula le righe della matrice finché non trova la chiusura ']'
+    char *line = NULL;
+    size_t line_cap = 0;
+    while (!strchr(buffer, ']')) {
+        ssize_t n = getline(&line, &line_cap, fp);
+        if (n == -1 || used + (size_t)n + 1 >= buffer_size) {
+            free(buffer);
+            free(line);
+            return parse_error(n == -1 ? "Missing closing ] in matrix" : "Matrix too long");
+        }
+        // Le righe sono separate da uno spazio, perché trim toglie l'a capo
+        buffer[used++] = ' ';
+        memcpy(buffer + used, line, (size_t)n + 1);
+        used += (size_t)n;
+    }
+    free(line);
+
+    // Pulizia delle parentesi tonde dalla stringa della matrice
+    char *mat_start = buffer;
+    char *mat_end = strchr(buffer, ']');
+    size_t len = mat_end - mat_start - 1;
+    char *clean = malloc(len + 1);
+    if (!clean) {
+        free(buffer);
+        return parse_error("Out of memory");
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (mat_start[1+i] != '(' && mat_start[1+i] != ')')
+            clean[j++] = mat_start[1+i];
+    }
+    clean[j] = 0;
+
+    // Parsing dei singoli elementi complessi della matrice
+    ComplexMatrix mat = alloc_complex_matrix(dim, dim);
+    char *save = NULL;
+    char *tok = strtok_r(clean, " \t\n\r", &save);
+    size_t idx = 0;
+    while (tok && idx < dim * dim) {
+        mat.data[idx++] = parse_complex(tok);
+        tok = strtok_r(NULL, " \t\n\r", &save);
+    }
+    free(buffer); free(clean);
+
+    if (idx != dim * dim || tok) {
+        free_complex_matrix(&mat);
+        return parse_error("Wrong number of matrix elements");
+    }
+
+    if (local) circuit_add_local_gate(c, name, qubits, k, mat);
+    else add_gate(c, name, mat);
+    return 0;
+}
+
+/**
+ * Gate parametrico: #param <nome> <RX|RY|RZ|PHASE>(<parametro>) <qubit>
+ */
+static int parse_param(const char *l, Circuit *c) {
+    char name[32], kind[8], param[32];
+    unsigned int qubit;
+    if (sscanf(l, "#param %31s %7[A-Z](%31[^)]) %u", name, kind, param, &qubit) != 4)
+        return parse_error("Invalid #param: expected '#param NAME RZ(theta) qubit'");
+    if (qubit >= c->n_qubits) return parse_error("Invalid #param: qubit out of range");
+
+    RotationKind rk;
+    if (strcmp(kind, "RX") == 0) rk = ROT_X;
+    else if (strcmp(kind, "RY") == 0) rk = ROT_Y;
+    else if (strcmp(kind, "RZ") == 0) rk = ROT_Z;
+    else if (strcmp(kind, "PHASE") == 0) rk = ROT_PHASE;
+    else return parse_error("Invalid #param: unknown rotation");
+
+    circuit_add_param_gate(c, name, rk, qubit, circuit_add_param(c, trim(param)));
+    return 0;
+}
+
+/**
+ * Gate letto da un file binario (es. unitaria salvata con --unitary):
+ * #import <nome> <file>
+ */
+static int parse_import(const char *l, Circuit *c) {
+    char name[32], path[MAX_LINE];
+    if (sscanf(l, "#import %31s %4095s", name, path) != 2) return parse_error("Invalid #import");
+    if (c->n_qubits > CIRCUIT_DENSE_MAX_QUBITS) return parse_error("#import on too many qubits for a dense gate");
+
+    FILE *bin = fopen(path, "rb");
+    if (!bin) return parse_error("Cannot open imported gate file");
+    ComplexMatrix mat;
+    int status = read_complex_matrix_binary(bin, &mat);
+    fclose(bin);
+    if (status != 0) return parse_error("Invalid binary gate file");
+
+    if (mat.rows != c->dim || mat.cols != c->dim) {
+        free_complex_matrix(&mat);
+        return parse_error("Imported gate has wrong dimension");
+    }
+    add_gate(c, name, mat);
+    return 0;
+}
+
+int parse_circ_file(const char *filename, Circuit *c) {
     FILE *fp = fopen(filename, "r");
-    if (!fp) parse_error("Cannot open circuit file");
+    if (!fp) return parse_error("Cannot open circuit file");
 
-    char line[MAX_LINE];
-    while (fgets(line, sizeof(line), fp)) {
+    // Righe lette per intero: una matrice o una sequenza può superare MAX_LINE
+    char *line = NULL;
+    size_t line_cap = 0;
+    int status = 0;
+    while (status == 0 && getline(&line, &line_cap, fp) != -1) {
         char *l = trim(line);
         if (*l == '\0') continue;
 
-        // Definizione del numero di qubit
+        // Il registro è già definito dal file di init: #qubits può solo confermarlo
         if (strncmp(l, "#qubits", 7) == 0) {
             unsigned int n;
-            if (sscanf(l, "#qubits %u", &n) != 1) parse_error("Invalid #qubits");
-            circuit_init(c, n);
+            if (sscanf(l, "#qubits %u", &n) != 1) status = parse_error("Invalid #qubits");
+            else if (n != c->n_qubits) status = parse_error("#qubits does not match the register");
         } 
         // Definizione di un nuovo operatore (Gate)
         else if (strncmp(l, "#define", 7) == 0) {
-            char name[32];
-            if (sscanf(l, "#define %31s", name) != 1) parse_error("Invalid gate name");
-
-            size_t dim = 1UL << c->n_qubits;
-            size_t buffer_size = dim * dim * 64 + MAX_LINE;
-            char *buffer = malloc(buffer_size); // Allocazione dinamica per sistemi grandi 
-            
-            char *start = strchr(l, '[');
-            if (!start) parse_error("Invalid matrix: missing '['");
-            strcpy(buffer, start);
-
-            // Accumula le righe della matrice finché non trova la chiusura ']'
-            while (!strchr(buffer, ']')) {
-                if (!fgets(line, sizeof(line), fp)) {
-                    free(buffer);
-                    parse_error("Missing closing ] in matrix");
-                }
-                strcat(buffer, line);
-            }
-
-            // Pulizia delle parentesi tonde dalla stringa della matrice
-            char *mat_start = strchr(buffer, '[');
-            char *mat_end = strchr(buffer, ']');
-            size_t len = mat_end - mat_start - 1;
-            char *clean = malloc(len + 1);
-            size_t j = 0;
-            for (size_t i = 0; i < len; i++) {
-                if (mat_start[1+i] != '(' && mat_start[1+i] != ')')
-                    clean[j++] = mat_start[1+i];
-            }
-            clean[j] = 0;
-
-            // Parsing dei singoli elementi complessi della matrice
-            ComplexMatrix mat = alloc_complex_matrix(dim, dim);
-            char *tok = strtok(clean, " \t\n\r");
-            size_t idx = 0;
-            while (tok && idx < dim * dim) {
-                mat.data[idx++] = parse_complex(tok);
-                tok = strtok(NULL, " \t\n\r");
-            }
-
-            circuit_add_gate(c, name, mat);
-            free(buffer); free(clean);
+            status = parse_define(l, fp, c);
         }
-        // Definizione della sequenza di esecuzione del circuito
-        else if (strncmp(l, "#circ", 5) == 0) {
-            char *p = l + 5;
-            char *tokens[MAX_TOKENS];
-            int count = 0;
-            char *tok = strtok(p, " \t\n\r");
-            while (tok && count < MAX_TOKENS) {
-                tokens[count++] = tok;
-                tok = strtok(NULL, " \t\n\r");
-            }
-            // Mappatura dei nomi dei gate ai loro indici interni
-            size_t *seq = malloc(sizeof(size_t) * count);
-            for (int i = 0; i < count; i++) {
-                size_t k;
-                for (k = 0; k < c->gate_count; k++) {
-                    if (strcmp(c->gates[k].name, tokens[i]) == 0) break;
-                }
-                if (k == c->gate_count) parse_error("Gate not defined");
-                seq[i] = k;
-            }
-            circuit_set_sequence(c, seq, count);
-            free(seq);
+        // Gate parametrico: #param <nome> <RX|RY|RZ|PHASE>(<parametro>) <qubit>
+        else if (strncmp(l, "#param", 6) == 0) {
+            status = parse_param(l, c);
+        }
+        // Valore di un parametro: #set <parametro> <valore>
+        else if (strncmp(l, "#set", 4) == 0) {
+            char param[32];
+            double value;
+            size_t p = c->param_count;
+            if (sscanf(l, "#set %31s %lf", param, &value) != 2) status = parse_error("Invalid #set");
+            else if ((p = circuit_find_param(c, param)) == c->param_count)
+                status = parse_error("Invalid #set: parameter not defined");
+            else circuit_set_param(c, p, value);
+        }
+        // Gate letto da un file binario (es. unitaria salvata con --unitary)
+        else if (strncmp(l, "#import", 7) == 0) {
+            status = parse_import(l, c);
+        }
+        // Sequenza di esecuzione (#circ) e blocchi ripetuti (#repeat), che si
+        // accodano nell'ordine del file
+        else if (strncmp(l, "#circ", 5) == 0 || strncmp(l, "#repeat", 7) == 0) {
+            char *text = read_statement(l, fp);
+            if (!text) status = -1;
+            else status = parse_sequence(text + (strncmp(text, "#circ", 5) == 0 ? 5 : 0), c);
+            free(text);
+        }
+        // Canali di rumore (usati dalla simulazione a traiettorie)
+        else if (strncmp(l, "#noise", 6) == 0) {
+            status = parse_noise(l + 6, c);
         }
     }
+    free(line);
     fclose(fp);
-}
\ No newline at end of file
+    return status;
+}
@@ -5,9 +5,18 @@
 
 /**
  * Parser per il file del circuito quantistico.
- * Legge le definizioni dei gate (#define) e la sequenza operativa (#circ).
+ * Legge le definizioni dei gate (#define, #import, #param), i valori dei
+ * parametri (#set), la sequenza operativa (#circ, anche su più righe che
+ * si accodano), i blocchi ripetuti (#repeat <count> { ... }) e gli eventuali
+ * canali di rumore (#noise). I blocchi #repeat restano registrati nel
+ * circuito e vanno risolti con circuit_expand_repeats prima dell'esecuzione.
+ * Il circuito deve essere già inizializzato (parse_init_file): un'eventuale
+ * direttiva #qubits deve coincidere con il numero di qubit del registro.
+ * Gli errori vengono segnalati su standard error; in caso di errore il
+ * circuito resta valido ma incompleto e va liberato con circuit_free.
  * Input: filename, c (puntatore alla struttura Circuit)
+ * Output: 0 in caso di successo, -1 se il file non è valido
  */
-void parse_circ_file(const char *filename, Circuit *c);
+int parse_circ_file(const char *filename, Circuit *c);
 
 #endif
\ No newline at end of file
@@ -1,6 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 #include "circuit.h"
-#include <pthread.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -14,6 +14,7 @@
  */
 typedef struct {
     const ComplexMatrix *matrix;   // Matrice dell'operatore (gate)
+    const SparseComplexMatrix *sparse; // Matrice in formato CSR (solo kernel sparso)
     const ComplexVector *input;    // Stato del sistema in ingresso
     ComplexVector *output;         // Buffer per il nuovo stato calcolato
     size_t start;                  // Indice della prima riga da elaborare
@@ -47,6 +48,129 @@ static void *thread_apply_matrix(void *arg) {
 }
 
 
+/**
+ * Variante sparsa di thread_apply_matrix: per ogni riga somma solo i
+ * prodotti con gli elementi non nulli della matrice (formato CSR).
+ */
+static void *thread_apply_sparse(void *arg) {
+    ThreadApplyTask *task = (ThreadApplyTask *)arg;
+    const SparseComplexMatrix *m = task->sparse;
+
+    for (size_t i = task->start; i < task->end; i++) {
+        Complex sum = {0.0, 0.0};
+
+        for (size_t k = m->row_ptr[i]; k < m->row_ptr[i + 1]; k++) {
+            Complex prod = complex_mul(m->values[k], task->input->data[m->col_idx[k]]);
+            sum = complex_add(sum, prod);
+        }
+
+        task->output->data[i] = sum;
+    }
+
+    return NULL;
+}
+
+/**
+ * Adattatore per il thread pool: applica il kernel scelto alle righe
+ * [begin, end) assegnate al worker.
+ */
+static void pool_apply_matrix(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    ThreadApplyTask task = *(const ThreadApplyTask *)arg;
+    task.start = begin;
+    task.end = end;
+    if (task.sparse)
+        thread_apply_sparse(&task);
+    else
+        thread_apply_matrix(&task);
+}
+
+
+/**
+ * Struttura LocalApplyTask: dati per applicare in place un gate locale.
+ * Gli indici della base sono divisi in gruppi di 2^k elementi che differiscono
+ * solo nei bit fisici del supporto; offsets[l] è la posizione dell'elemento
+ * locale l all'interno del gruppo.
+ */
+typedef struct {
+    const Complex *matrix;                          // Matrice locale 2^k x 2^k
+    unsigned int k;                                 // Numero di qubit del supporto
+    unsigned int bits[GATE_LOCAL_MAX_QUBITS];       // Bit fisici, in ordine crescente
+    size_t offsets[1 << GATE_LOCAL_MAX_QUBITS];
+    Complex *state;
+} LocalApplyTask;
+
+/**
+ * Applica il gate locale ai gruppi [begin, end): per ogni gruppo raccoglie le
+ * 2^k ampiezze, le moltiplica per la matrice locale e le riscrive.
+ */
+static void pool_apply_local(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const LocalApplyTask *task = (const LocalApplyTask *)arg;
+    size_t kdim = (size_t)1 << task->k;
+    Complex in[1 << GATE_LOCAL_MAX_QUBITS];
+
+    for (size_t g = begin; g < end; g++) {
+        // Indice base del gruppo: inserisce uno zero in ogni bit del supporto
+        size_t base = g;
+        for (unsigned int b = 0; b < task->k; b++) {
+            size_t low = base & (((size_t)1 << task->bits[b]) - 1);
+            base = ((base ^ low) << 1) | low;
+        }
+
+        for (size_t l = 0; l < kdim; l++)
+            in[l] = task->state[base + task->offsets[l]];
+
+        for (size_t r = 0; r < kdim; r++) {
+            const Complex *row = task->matrix + r * kdim;
+            Complex sum = {0.0, 0.0};
+            for (size_t l = 0; l < kdim; l++)
+                sum = complex_add(sum, complex_mul(row[l], in[l]));
+            task->state[base + task->offsets[r]] = sum;
+        }
+    }
+}
+
+/**
+ * Struttura PermuteTask: passata di permutazione dei bit dell'indice.
+ * L'indice sorgente di ogni destinazione j si ottiene byte per byte:
+ * table[b * 256 + v] è il contributo del byte b di j, con valore v.
+ */
+typedef struct {
+    const Complex *input;
+    Complex *output;
+    size_t bytes;
+    const size_t *table;
+} PermuteTask;
+
+/**
+ * Scrive le destinazioni [begin, end) leggendo dalle sorgenti permutate.
+ * Le scritture sono sequenziali; le letture di un blocco toccano solo gli
+ * indici che differiscono nei bit spostati.
+ */
+static void pool_permute(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const PermuteTask *task = (const PermuteTask *)arg;
+
+    for (size_t j = begin; j < end; j++) {
+        size_t src = 0;
+        for (size_t b = 0; b < task->bytes; b++)
+            src |= task->table[b * 256 + ((j >> (8 * b)) & 0xff)];
+        task->output[j] = task->input[src];
+    }
+}
+
+/**
+ * Esegue fn sul pool, oppure direttamente nel thread chiamante se pool è NULL.
+ */
+static void run_items(ThreadPool *pool, ThreadPoolFn fn, void *arg, size_t n_items, size_t chunk) {
+    if (pool)
+        threadpool_run(pool, fn, arg, n_items, chunk);
+    else
+        fn(arg, 0, n_items, 0);
+}
+
+
 /* INIZIALIZZAZIONE CIRCUITO */
 
 /**
@@ -54,15 +178,41 @@ static void *thread_apply_matrix(void *arg) {
  * e alloca il vettore di stato iniziale.
  */
 void circuit_init(Circuit *c, unsigned int n_qubits) {
+    circuit_init_template(c, n_qubits);
+
+    // Registri troppo grandi per lo stato denso partono con lo stato sparso vuoto
+    if (n_qubits <= CIRCUIT_DENSE_MAX_QUBITS)
+        c->state = alloc_complex_vector(c->dim);
+    else
+        c->sparse = alloc_sparse_vector(1);
+}
+
+/**
+ * Inizializza un circuito senza stato (né denso né sparso), usato come
+ * contenitore di gate e sequenza da condividere tra più esecuzioni.
+ */
+void circuit_init_template(Circuit *c, unsigned int n_qubits) {
     c->n_qubits = n_qubits;
     // La dimensione del vettore è 2^n_qubits
     c->dim = (size_t)1 << n_qubits; 
 
-    c->state = alloc_complex_vector(c->dim);
+    c->state.data = NULL;
+    c->state.size = 0;
+    memset(&c->sparse, 0, sizeof(SparseVector));
+    c->layout = NULL;
     c->gates = NULL;
     c->gate_count = 0;
     c->sequence = NULL;
     c->sequence_len = 0;
+    c->repeats = NULL;
+    c->repeat_count = 0;
+    c->noise = NULL;
+    c->noise_count = 0;
+    c->params = NULL;
+    c->param_values = NULL;
+    c->param_count = 0;
+    c->param_gates = NULL;
+    c->param_gate_count = 0;
 }
 
 
@@ -82,9 +232,147 @@ void circuit_add_gate(Circuit *c, const char *name, ComplexMatrix matrix) {
     // Copia il nome del gate e assegna la matrice associata
     c->gates[c->gate_count].name = strdup(name);
     c->gates[c->gate_count].matrix = matrix;
+    memset(&c->gates[c->gate_count].sparse, 0, sizeof(SparseComplexMatrix));
+    c->gates[c->gate_count].analyzed = 0;
+    c->gates[c->gate_count].support_len = 0;
+    memset(&c->gates[c->gate_count].local, 0, sizeof(ComplexMatrix));
+    c->gates[c->gate_count].transform = TRANSFORM_NONE;
+    c->gates[c->gate_count].reverse_in = 0;
+    c->gates[c->gate_count].reverse_out = 0;
     c->gate_count++;
 }
 
+/**
+ * Registra un gate definito solo sui qubit su cui agisce: l'elemento locale
+ * con bit b pari al valore del qubit qubits[b]. La matrice viene riordinata
+ * sul supporto crescente; la matrice densa non viene costruita (vedi
+ * circuit_gate_matrix). La matrice 'local' passa al circuito.
+ */
+void circuit_add_local_gate(Circuit *c, const char *name, const unsigned int *qubits,
+                            unsigned int k, ComplexMatrix local) {
+    unsigned int support[GATE_LOCAL_MAX_QUBITS], pos[GATE_LOCAL_MAX_QUBITS];
+    for (unsigned int b = 0; b < k; b++) {
+        // Inserimento ordinato dei qubit
+        unsigned int r = b;
+        while (r > 0 && support[r - 1] > qubits[b]) {
+            support[r] = support[r - 1];
+            r--;
+        }
+        support[r] = qubits[b];
+    }
+    for (unsigned int b = 0; b < k; b++)
+        for (unsigned int r = 0; r < k; r++)
+            if (support[r] == qubits[b]) pos[b] = r;
+
+    // Indice locale nell'ordine dato -> indice nell'ordine crescente del supporto
+    size_t kdim = (size_t)1 << k;
+    size_t canon[1 << GATE_LOCAL_MAX_QUBITS];
+    for (size_t l = 0; l < kdim; l++) {
+        canon[l] = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (l & ((size_t)1 << b)) canon[l] |= (size_t)1 << pos[b];
+    }
+    ComplexMatrix sorted = alloc_complex_matrix(kdim, kdim);
+    for (size_t r = 0; r < kdim; r++)
+        for (size_t l = 0; l < kdim; l++)
+            MAT(&sorted, canon[r], canon[l]) = MAT(&local, r, l);
+    free_complex_matrix(&local);
+
+    ComplexMatrix dense = {0, 0, NULL};
+    circuit_add_gate(c, name, dense);
+    Gate *g = &c->gates[c->gate_count - 1];
+    memcpy(g->support, support, k * sizeof(unsigned int));
+    g->support_len = k;
+    g->local = sorted;
+    g->analyzed = 1;
+}
+
+
+/**
+ * Restituisce la matrice densa del gate. Per i gate che hanno solo la matrice
+ * locale viene costruita alla prima richiesta (identità sugli altri qubit) e
+ * conservata nel gate: serve solo a unitaria, traiettorie, ottimizzatore e
+ * potenze dei #repeat, mentre l'esecuzione usa la matrice locale.
+ * Output: matrice densa, NULL se il registro ha più di GATE_DENSE_MAX_QUBITS qubit
+ */
+const ComplexMatrix *circuit_gate_matrix(Circuit *c, size_t gate) {
+    Gate *g = &c->gates[gate];
+    if (g->matrix.data) return &g->matrix;
+    if (!g->local.data || c->n_qubits > GATE_DENSE_MAX_QUBITS) return NULL;
+
+    unsigned int k = g->support_len;
+    size_t kdim = (size_t)1 << k;
+    size_t offsets[1 << GATE_LOCAL_MAX_QUBITS];
+    size_t mask = 0;
+    for (size_t l = 0; l < kdim; l++) {
+        offsets[l] = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (l & ((size_t)1 << b)) offsets[l] |= (size_t)1 << g->support[b];
+    }
+    for (unsigned int b = 0; b < k; b++) mask |= (size_t)1 << g->support[b];
+
+    ComplexMatrix dense = alloc_complex_matrix(c->dim, c->dim);
+    memset(dense.data, 0, c->dim * c->dim * sizeof(Complex));
+    for (size_t i = 0; i < c->dim; i++) {
+        size_t r = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (i & ((size_t)1 << g->support[b])) r |= (size_t)1 << b;
+        for (size_t l = 0; l < kdim; l++)
+            MAT(&dense, i, (i & ~mask) | offsets[l]) = MAT(&g->local, r, l);
+    }
+    g->matrix = dense;
+    return &g->matrix;
+}
+
+/**
+ * Aggiunge il supporto del gate locale g ai qubit ordinati u[0..ulen);
+ * u deve avere spazio per ulen + g->support_len elementi.
+ * Output: nuova lunghezza di u
+ */
+unsigned int gate_support_union(const Gate *g, unsigned int *u, unsigned int ulen) {
+    for (unsigned int b = 0; b < g->support_len; b++) {
+        unsigned int r = ulen;
+        while (r > 0 && u[r - 1] > g->support[b]) r--;
+        if (r > 0 && u[r - 1] == g->support[b]) continue;
+        memmove(u + r + 1, u + r, (ulen - r) * sizeof(unsigned int));
+        u[r] = g->support[b];
+        ulen++;
+    }
+    return ulen;
+}
+
+/**
+ * Matrice del gate locale g estesa ai qubit ordinati u[0..ulen) che ne
+ * contengono il supporto (identità sui qubit di u fuori dal supporto):
+ * il bit r dell'indice è il qubit u[r].
+ */
+ComplexMatrix gate_local_on(const Gate *g, const unsigned int *u, unsigned int ulen) {
+    // pos[b]: posizione in u del qubit g->support[b]
+    unsigned int pos[GATE_LOCAL_MAX_QUBITS];
+    size_t mask = 0;
+    for (unsigned int b = 0; b < g->support_len; b++) {
+        for (unsigned int r = 0; r < ulen; r++)
+            if (u[r] == g->support[b]) pos[b] = r;
+        mask |= (size_t)1 << pos[b];
+    }
+
+    size_t udim = (size_t)1 << ulen;
+    ComplexMatrix m = alloc_complex_matrix(udim, udim);
+    memset(m.data, 0, udim * udim * sizeof(Complex));
+    for (size_t i = 0; i < udim; i++) {
+        for (size_t j = 0; j < udim; j++) {
+            if ((i ^ j) & ~mask) continue;
+            size_t r = 0, l = 0;
+            for (unsigned int b = 0; b < g->support_len; b++) {
+                if (i & ((size_t)1 << pos[b])) r |= (size_t)1 << b;
+                if (j & ((size_t)1 << pos[b])) l |= (size_t)1 << b;
+            }
+            MAT(&m, i, j) = MAT(&g->local, r, l);
+        }
+    }
+    return m;
+}
+
 
 /* DEFINIZIONE SEQUENZA GATE */
 
@@ -103,67 +391,510 @@ void circuit_set_sequence(Circuit *c, const size_t *sequence, size_t length) {
 }
 
 
-/* ESECUZIONE CIRCUITO (PARALLELA) */
+/**
+ * Aggiunge i gate indicati in coda alla sequenza (più righe #circ e i
+ * blocchi #repeat si concatenano).
+ */
+void circuit_append_sequence(Circuit *c, const size_t *sequence, size_t length) {
+    size_t *grown = realloc(c->sequence, (c->sequence_len + length) * sizeof(size_t));
+    if (!grown && c->sequence_len + length > 0) {
+        perror("Errore realloc sequence");
+        exit(EXIT_FAILURE);
+    }
+    c->sequence = grown;
+    memcpy(c->sequence + c->sequence_len, sequence, length * sizeof(size_t));
+    c->sequence_len += length;
+}
+
+/**
+ * Registra un blocco #repeat sulla sequenza corrente.
+ */
+void circuit_add_repeat(Circuit *c, RepeatBlock block) {
+    c->repeats = realloc(c->repeats, (c->repeat_count + 1) * sizeof(RepeatBlock));
+    if (!c->repeats) {
+        perror("Errore realloc repeats");
+        exit(EXIT_FAILURE);
+    }
+    c->repeats[c->repeat_count++] = block;
+}
+
+
+/* CANALI DI RUMORE */
 
 /**
- * Esegue la simulazione applicando sequenzialmente i gate allo stato.
- * La parallelizzazione avviene dividendo il carico di lavoro del prodotto 
- * matrice-vettore tra il numero di thread specificato.
+ * Aggiunge un canale di rumore al circuito. Il circuito acquisisce
+ * l'array channel.kraus, che verrà liberato da circuit_free.
  */
-void circuit_execute_parallel(Circuit *c, size_t n_threads) {
-    if (c->sequence_len == 0) return;
+void circuit_add_noise(Circuit *c, NoiseChannel channel) {
+    c->noise = realloc(c->noise, (c->noise_count + 1) * sizeof(NoiseChannel));
+    if (!c->noise) {
+        perror("Errore realloc noise");
+        exit(EXIT_FAILURE);
+    }
+    c->noise[c->noise_count++] = channel;
+}
 
-    size_t dim = c->dim;
-    // Buffer ausiliario per memorizzare il risultato dell'applicazione di un gate
-    ComplexVector intermediate_state = alloc_complex_vector(dim);
-    
-    // Puntatori per gestire lo scambio (swap) tra stato corrente e risultato
-    ComplexVector *current_in = &(c->state);
-    ComplexVector *current_out = &intermediate_state;
 
-    // Itera attraverso ogni gate presente nella sequenza #circ
-    for (size_t s = 0; s < c->sequence_len; s++) {
-        const ComplexMatrix *gate = &c->gates[c->sequence[s]].matrix;
+/* GATE PARAMETRICI */
+
+/**
+ * Restituisce l'indice del parametro con il nome indicato, oppure param_count.
+ */
+size_t circuit_find_param(const Circuit *c, const char *name) {
+    size_t p;
+    for (p = 0; p < c->param_count; p++) {
+        if (strcmp(c->params[p], name) == 0) break;
+    }
+    return p;
+}
 
-        pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
-        ThreadApplyTask *tasks = malloc(n_threads * sizeof(ThreadApplyTask));
+/**
+ * Registra un parametro (valore iniziale 0) se non esiste già.
+ * Output: indice del parametro
+ */
+size_t circuit_add_param(Circuit *c, const char *name) {
+    size_t p = circuit_find_param(c, name);
+    if (p < c->param_count) return p;
+
+    c->params = realloc(c->params, (c->param_count + 1) * sizeof(char *));
+    c->param_values = realloc(c->param_values, (c->param_count + 1) * sizeof(double));
+    if (!c->params || !c->param_values) {
+        perror("Errore realloc params");
+        exit(EXIT_FAILURE);
+    }
+    c->params[p] = strdup(name);
+    c->param_values[p] = 0.0;
+    c->param_count++;
+    return p;
+}
 
-        // Calcolo della ripartizione del lavoro tra i thread
-        size_t block = dim / n_threads;
-        size_t rem = dim % n_threads;
-        size_t idx = 0;
+/**
+ * Aggiorna la matrice 2 x 2 della rotazione per il valore corrente del
+ * parametro. Se la matrice densa è già stata costruita (circuit_gate_matrix)
+ * vengono riscritti solo i suoi 2 elementi non nulli per riga.
+ */
+static void build_param_matrix(Circuit *c, const ParamGate *pg) {
+    double theta = c->param_values[pg->param];
+    double ch = cos(theta / 2.0), sh = sin(theta / 2.0);
+    Complex u[4];
+
+    switch (pg->kind) {
+        case ROT_X:
+            u[0] = (Complex){ch, 0.0};  u[1] = (Complex){0.0, -sh};
+            u[2] = (Complex){0.0, -sh}; u[3] = (Complex){ch, 0.0};
+            break;
+        case ROT_Y:
+            u[0] = (Complex){ch, 0.0};  u[1] = (Complex){-sh, 0.0};
+            u[2] = (Complex){sh, 0.0};  u[3] = (Complex){ch, 0.0};
+            break;
+        case ROT_Z:
+            u[0] = (Complex){ch, -sh};  u[1] = (Complex){0.0, 0.0};
+            u[2] = (Complex){0.0, 0.0}; u[3] = (Complex){ch, sh};
+            break;
+        case ROT_PHASE:
+            u[0] = (Complex){1.0, 0.0}; u[1] = (Complex){0.0, 0.0};
+            u[2] = (Complex){0.0, 0.0}; u[3] = (Complex){cos(theta), sin(theta)};
+            break;
+    }
 
-        for (size_t t = 0; t < n_threads; t++) {
-            size_t len = block + (rem > 0 ? 1 : 0);
-            if (rem > 0) rem--;
+    Gate *g = &c->gates[pg->gate];
+    memcpy(g->local.data, u, sizeof(u));
 
-            tasks[t].matrix = gate;
-            tasks[t].input = current_in;
-            tasks[t].output = current_out;
-            tasks[t].start = idx;
-            tasks[t].end = idx + len;
+    // M[i][j] = u[b(i)][b(j)] se i e j coincidono su tutti gli altri qubit
+    ComplexMatrix *m = &g->matrix;
+    size_t bit = (size_t)1 << pg->qubit;
+    for (size_t i = 0; m->data && i < c->dim; i++) {
+        size_t bi = (i & bit) ? 1 : 0;
+        MAT(m, i, i & ~bit) = u[bi * 2 + 0];
+        MAT(m, i, i | bit) = u[bi * 2 + 1];
+    }
 
-            // Creazione del thread per il calcolo della porzione assegnata
-            pthread_create(&threads[t], NULL, thread_apply_matrix, &tasks[t]);
-            idx += len;
+    // La copia CSR non è più valida
+    free_sparse_matrix(&g->sparse);
+}
+
+/**
+ * Definisce un gate parametrico: rotazione 'kind' sul qubit indicato,
+ * con angolo dato dal parametro 'param'. Il gate è locale (matrice 2 x 2);
+ * la matrice densa viene costruita solo se serve (circuit_gate_matrix).
+ */
+void circuit_add_param_gate(Circuit *c, const char *name, RotationKind kind,
+                            unsigned int qubit, size_t param) {
+    ComplexMatrix dense = {0, 0, NULL};
+    circuit_add_gate(c, name, dense);
+    Gate *g = &c->gates[c->gate_count - 1];
+    g->local = alloc_complex_matrix(2, 2);
+    g->support[0] = qubit;
+    g->support_len = 1;
+    g->analyzed = 1;
+
+    c->param_gates = realloc(c->param_gates, (c->param_gate_count + 1) * sizeof(ParamGate));
+    if (!c->param_gates) {
+        perror("Errore realloc param gates");
+        exit(EXIT_FAILURE);
+    }
+
+    ParamGate *pg = &c->param_gates[c->param_gate_count++];
+    pg->gate = c->gate_count - 1;
+    pg->kind = kind;
+    pg->qubit = qubit;
+    pg->param = param;
+    build_param_matrix(c, pg);
+}
+
+/**
+ * Assegna un valore al parametro e aggiorna solo le matrici dei gate
+ * che ne dipendono.
+ */
+void circuit_set_param(Circuit *c, size_t param, double value) {
+    c->param_values[param] = value;
+    for (size_t k = 0; k < c->param_gate_count; k++) {
+        if (c->param_gates[k].param == param)
+            build_param_matrix(c, &c->param_gates[k]);
+    }
+}
+
+
+/* ANALISI DI LOCALITÀ DEI GATE */
+
+/**
+ * Verifica se il gate agisce banalmente sul qubit con maschera 'bit', cioè se
+ * M = M' (x) I su quel qubit: gli elementi che cambiano il bit sono nulli e
+ * i blocchi con bit 0 e bit 1 coincidono.
+ */
+static int qubit_is_trivial(const ComplexMatrix *m, size_t bit) {
+    const Complex zero = {0.0, 0.0};
+    for (size_t i = 0; i < m->rows; i++) {
+        for (size_t j = 0; j < m->cols; j++) {
+            if ((i ^ j) & bit) {
+                if (!complex_equal(MAT(m, i, j), zero, EPSILON)) return 0;
+            } else if (i & bit) {
+                if (!complex_equal(MAT(m, i, j), MAT(m, i ^ bit, j ^ bit), EPSILON)) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Determina i qubit su cui il gate agisce e, se sono al più
+ * GATE_LOCAL_MAX_QUBITS, estrae la matrice locale corrispondente.
+ * L'analisi viene fatta una sola volta per gate.
+ */
+static void gate_analyze(Gate *g, unsigned int n_qubits) {
+    if (g->analyzed || !g->matrix.data) return;
+    g->analyzed = 1;
+
+    unsigned int k = 0;
+    for (unsigned int q = 0; q < n_qubits; q++) {
+        if (qubit_is_trivial(&g->matrix, (size_t)1 << q)) continue;
+        if (k == GATE_LOCAL_MAX_QUBITS) return;   // Gate non locale
+        g->support[k++] = q;
+    }
+    g->support_len = k;
+
+    // Elemento locale l -> indice della base con i bit del supporto dati da l
+    size_t kdim = (size_t)1 << k;
+    size_t idx[1 << GATE_LOCAL_MAX_QUBITS];
+    for (size_t l = 0; l < kdim; l++) {
+        idx[l] = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (l & ((size_t)1 << b)) idx[l] |= (size_t)1 << g->support[b];
+    }
+
+    g->local = alloc_complex_matrix(kdim, kdim);
+    for (size_t r = 0; r < kdim; r++)
+        for (size_t l = 0; l < kdim; l++)
+            MAT(&g->local, r, l) = MAT(&g->matrix, idx[r], idx[l]);
+}
+
+
+/**
+ * Analizza la località del gate indicato (vedi Gate.support e Gate.local).
+ */
+void circuit_analyze_gate(Circuit *c, size_t gate) {
+    gate_analyze(&c->gates[gate], c->n_qubits);
+}
+
+
+/* LAYOUT DEI QUBIT */
+
+// Bit fisici "bassi": le coppie di ampiezze distano al più 2^8 * 16 B = 4 KiB (una pagina)
+#define LAYOUT_LOW_QUBITS 8
+// Gate esaminati in avanti per decidere una rimappatura
+#define LAYOUT_WINDOW 32
+// Costo stimato, in passate sullo stato, di ogni bit alto di un gate locale
+#define LAYOUT_HIGH_BIT_COST 0.5
+// Costo stimato di una passata di permutazione (lettura sparsa + scrittura);
+// ogni layout scelto richiede anche la passata che ripristina l'identità
+#define LAYOUT_PASS_COST 2.0
+// Destinazioni consecutive assegnate a ogni blocco della passata di permutazione
+#define LAYOUT_PERMUTE_BLOCK 4096
+
+static unsigned int physical_bit(const Circuit *c, unsigned int q) {
+    return c->layout ? c->layout[q] : q;
+}
+
+/**
+ * Porta lo stato dal layout corrente al layout 'target' (NULL = identità)
+ * con una passata parallela fuori posto; i buffer vengono scambiati.
+ */
+static void set_layout(Circuit *c, const unsigned int *target, ThreadPool *pool,
+                       ComplexVector *scratch) {
+    unsigned int n = c->n_qubits;
+    int same = 1;
+    for (unsigned int q = 0; q < n && same; q++)
+        same = physical_bit(c, q) == (target ? target[q] : q);
+    if (same) return;
+
+    // Bit fisico di destinazione p -> bit fisico di origine (stesso qubit logico)
+    unsigned int source[8 * sizeof(size_t)];
+    for (unsigned int q = 0; q < n; q++)
+        source[target ? target[q] : q] = physical_bit(c, q);
+
+    size_t bytes = (n + 7) / 8;
+    size_t *table = calloc(bytes * 256, sizeof(size_t));
+    if (!table) {
+        perror("Errore calloc layout table");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t b = 0; b < bytes; b++) {
+        for (size_t v = 0; v < 256; v++) {
+            for (unsigned int t = 0; t < 8 && 8 * b + t < n; t++)
+                if (v & ((size_t)1 << t))
+                    table[b * 256 + v] |= (size_t)1 << source[8 * b + t];
+        }
+    }
+
+    PermuteTask task = {c->state.data, scratch->data, bytes, table};
+    run_items(pool, pool_permute, &task, c->dim, LAYOUT_PERMUTE_BLOCK);
+    free(table);
+
+    Complex *temp_data = c->state.data;
+    c->state.data = scratch->data;
+    scratch->data = temp_data;
+
+    if (!target) {
+        free(c->layout);
+        c->layout = NULL;
+        return;
+    }
+    if (!c->layout) {
+        c->layout = malloc(n * sizeof(unsigned int));
+        if (!c->layout) {
+            perror("Errore malloc layout");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(c->layout, target, n * sizeof(unsigned int));
+}
+
+/* Costo stimato dei bit alti dei gate locali in [s, end) con il layout 'map' */
+static double window_cost(const Circuit *c, size_t s, size_t end, const unsigned int *map) {
+    double cost = 0.0;
+    for (; s < end; s++) {
+        const Gate *g = &c->gates[c->sequence[s]];
+        for (unsigned int b = 0; b < g->support_len; b++)
+            if (map[g->support[b]] >= LAYOUT_LOW_QUBITS) cost += LAYOUT_HIGH_BIT_COST;
+    }
+    return cost;
+}
+
+/**
+ * Lookahead sulla sequenza a partire dalla posizione s: propone un layout
+ * che porta nei bit bassi i qubit più usati dai prossimi gate locali.
+ * Output: 1 se il risparmio stimato supera il costo della permutazione
+ * (candidate contiene il nuovo layout), 0 altrimenti. Se lo stato è
+ * nell'ordine logico e la finestra termina a un gate non locale o alla fine
+ * della sequenza, il costo comprende anche la passata di ripristino.
+ */
+static int plan_layout(Circuit *c, size_t s, unsigned int *candidate) {
+    unsigned int n = c->n_qubits;
+    unsigned int current[8 * sizeof(size_t)];
+    size_t uses[8 * sizeof(size_t)] = {0};
+    for (unsigned int q = 0; q < n; q++) current[q] = physical_bit(c, q);
+
+    // La finestra termina al primo gate non locale o trasformata, che
+    // richiede il layout identità
+    size_t end = s;
+    int restore = 0;
+    while (end < c->sequence_len && end - s < LAYOUT_WINDOW) {
+        Gate *g = &c->gates[c->sequence[end]];
+        gate_analyze(g, n);
+        if (!g->local.data || g->transform != TRANSFORM_NONE) {
+            restore = 1;
+            break;
+        }
+        for (unsigned int b = 0; b < g->support_len; b++) uses[g->support[b]]++;
+        end++;
+    }
+
+    // Qubit ordinati per utilizzo decrescente, a parità per bit fisico corrente
+    unsigned int order[8 * sizeof(size_t)];
+    for (unsigned int q = 0; q < n; q++) {
+        unsigned int r = q;
+        while (r > 0) {
+            unsigned int p = order[r - 1];
+            if (uses[p] > uses[q] || (uses[p] == uses[q] && current[p] < current[q])) break;
+            order[r] = p;
+            r--;
+        }
+        order[r] = q;
+    }
+    for (unsigned int r = 0; r < n; r++) candidate[order[r]] = r;
+
+    if (end == c->sequence_len) restore = 1;
+
+    // Da un layout già permutato il ripristino è dovuto comunque
+    int identity = 1;
+    for (unsigned int q = 0; q < n && identity; q++) identity = candidate[q] == q;
+    if (identity || c->layout) restore = 0;
+
+    double saving = window_cost(c, s, end, current) - window_cost(c, s, end, candidate);
+    return saving > LAYOUT_PASS_COST * (restore ? 2.0 : 1.0);
+}
+
+/**
+ * Applica in place un gate locale tenendo conto del layout corrente.
+ */
+static void apply_local_gate(Circuit *c, const Gate *g, ThreadPool *pool, size_t chunk) {
+    LocalApplyTask task;
+    task.matrix = g->local.data;
+    task.k = g->support_len;
+    task.state = c->state.data;
+
+    unsigned int phys[GATE_LOCAL_MAX_QUBITS];
+    for (unsigned int b = 0; b < task.k; b++) {
+        phys[b] = physical_bit(c, g->support[b]);
+        // Inserimento ordinato dei bit fisici
+        unsigned int r = b;
+        while (r > 0 && task.bits[r - 1] > phys[b]) {
+            task.bits[r] = task.bits[r - 1];
+            r--;
+        }
+        task.bits[r] = phys[b];
+    }
+
+    size_t kdim = (size_t)1 << task.k;
+    for (size_t l = 0; l < kdim; l++) {
+        task.offsets[l] = 0;
+        for (unsigned int b = 0; b < task.k; b++)
+            if (l & ((size_t)1 << b)) task.offsets[l] |= (size_t)1 << phys[b];
+    }
+
+    // chunk è espresso in righe dello stato: ogni gruppo ne contiene 2^k
+    run_items(pool, pool_apply_local, &task, c->dim >> task.k, chunk >> task.k);
+}
+
+
+/* ESECUZIONE CIRCUITO (THREAD POOL) */
+
+/**
+ * Esegue la simulazione sul pool di thread residenti, dividendo ogni gate
+ * tra i thread invece di creare e distruggere i thread a ogni gate.
+ * I gate locali vengono applicati con KERNEL_LOCAL, gli altri con il
+ * prodotto denso.
+ * scratch: buffer ausiliario di dimensione dim riutilizzabile tra esecuzioni
+ * (NULL per allocarne uno temporaneo). Al termine può contenere i dati del
+ * vecchio stato: i due buffer vengono scambiati, non copiati.
+ */
+void circuit_execute_pool(Circuit *c, ThreadPool *pool, ComplexVector *scratch) {
+    circuit_execute_config(c, pool, 0, KERNEL_LOCAL, scratch);
+}
+
+/**
+ * Esecuzione sul pool con granularità e kernel espliciti.
+ * pool: NULL per eseguire tutto nel thread chiamante.
+ * chunk: righe per blocco assegnato dinamicamente (0 = un blocco per thread).
+ * Con KERNEL_SPARSE le matrici CSR dei gate vengono costruite alla prima
+ * esecuzione e conservate nel circuito.
+ * I gate riconosciuti come DFT o Walsh-Hadamard usano sempre il kernel
+ * veloce di transform_apply.
+ * Con KERNEL_LOCAL (e per i gate senza matrice densa con qualsiasi kernel),
+ * prima di un gate che tocca bit fisici alti, un lookahead sulla sequenza
+ * decide se conviene permutare i qubit dello stato; il layout viene riportato
+ * all'identità prima di ogni prodotto denso o CSR e al termine.
+ */
+void circuit_execute_config(Circuit *c, ThreadPool *pool, size_t chunk,
+                            KernelKind kernel, ComplexVector *scratch) {
+    if (c->sequence_len == 0) return;
+    if (!c->state.data) {
+        fprintf(stderr, "Error: %u qubits exceed the dense state limit\n", c->n_qubits);
+        exit(EXIT_FAILURE);
+    }
+
+    ComplexVector local = {NULL, 0};
+    if (!scratch) {
+        local = alloc_complex_vector(c->dim);
+        scratch = &local;
+    }
+    if (scratch->size != c->dim) {
+        fprintf(stderr, "Error: scratch buffer size mismatch\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ThreadApplyTask task;
+    task.input = &c->state;
+    task.output = scratch;
+    unsigned int candidate[8 * sizeof(size_t)];
+
+    for (size_t s = 0; s < c->sequence_len; s++) {
+        Gate *gate = &c->gates[c->sequence[s]];
+
+        // DFT e Walsh-Hadamard: trasformata veloce in place, con qualsiasi kernel
+        if (gate->transform != TRANSFORM_NONE) {
+            set_layout(c, NULL, pool, scratch);
+            transform_apply(&c->state, gate->transform, gate->reverse_in, gate->reverse_out, pool);
+            continue;
         }
 
-        // Sincronizzazione: attende che tutti i thread finiscano il gate corrente
-        for (size_t t = 0; t < n_threads; t++)
-            pthread_join(threads[t], NULL);
+        // I gate senza matrice densa sono sempre applicati come gate locali
+        if (kernel == KERNEL_LOCAL || !gate->matrix.data) {
+            gate_analyze(gate, c->n_qubits);
+            if (gate->local.data) {
+                int high = 0;
+                for (unsigned int b = 0; b < gate->support_len; b++)
+                    if (physical_bit(c, gate->support[b]) >= LAYOUT_LOW_QUBITS) high = 1;
+                if (high && plan_layout(c, s, candidate))
+                    set_layout(c, candidate, pool, scratch);
+
+                apply_local_gate(c, gate, pool, chunk);
+                continue;
+            }
+        }
 
-        // SWAP DEI DATI: Il risultato (output) diventa l'input per il gate successivo.
-        // Si scambiano i puntatori agli array di dati per massimizzare l'efficienza.
-        Complex *temp_data = current_in->data;
-        current_in->data = current_out->data;
-        current_out->data = temp_data;
+        // Il prodotto con la matrice densa (o CSR) vuole lo stato in ordine logico:
+        // un gate locale precedente può averlo permutato con qualsiasi kernel
+        set_layout(c, NULL, pool, scratch);
+        task.matrix = &gate->matrix;
+        task.sparse = NULL;
+        if (kernel == KERNEL_SPARSE) {
+            if (!gate->sparse.row_ptr) gate->sparse = sparse_from_matrix(&gate->matrix);
+            task.sparse = &gate->sparse;
+        }
+        run_items(pool, pool_apply_matrix, &task, c->dim, chunk);
 
-        free(threads);
-        free(tasks);
+        // SWAP DEI DATI: il risultato diventa l'input del gate successivo
+        Complex *temp_data = c->state.data;
+        c->state.data = scratch->data;
+        scratch->data = temp_data;
     }
 
-    // Il vettore 'intermediate_state' ora contiene i dati vecchi, lo liberiamo.
-    free_complex_vector(&intermediate_state);
+    // Lo stato torna nell'ordine logico dei qubit
+    set_layout(c, NULL, pool, scratch);
+    free_complex_vector(&local);
+}
+
+
+/* ESECUZIONE CIRCUITO (SERIALE) */
+
+/**
+ * Esegue il circuito interamente nel thread chiamante, senza alcuna
+ * sincronizzazione. Pensata per i circuiti piccoli eseguiti in parallelo
+ * a livello di job; scratch ha la stessa semantica di circuit_execute_pool.
+ */
+void circuit_execute_serial(Circuit *c, ComplexVector *scratch) {
+    circuit_execute_config(c, NULL, 0, KERNEL_LOCAL, scratch);
 }
 
 
@@ -176,22 +907,70 @@ void circuit_free(Circuit *c) {
     for (size_t i = 0; i < c->gate_count; i++) {
         free(c->gates[i].name);
         free_complex_matrix(&c->gates[i].matrix);
+        free_sparse_matrix(&c->gates[i].sparse);
+        free_complex_matrix(&c->gates[i].local);
     }
     free(c->gates);
+    free(c->layout);
     free(c->sequence);
+    free(c->repeats);
+    for (size_t i = 0; i < c->noise_count; i++)
+        free(c->noise[i].kraus);
+    free(c->noise);
+    for (size_t i = 0; i < c->param_count; i++)
+        free(c->params[i]);
+    free(c->params);
+    free(c->param_values);
+    free(c->param_gates);
     free_complex_vector(&c->state);
+    free_sparse_vector(&c->sparse);
 }
 
 
 /* FUNZIONI DI OUTPUT/DEBUG */
 
 void circuit_print_state(const Circuit *c) {
-    print_complex_vector(&c->state);
+    circuit_fprint_state(stdout, c);
+}
+
+/**
+ * Stampa lo stato nell'ordine logico dei qubit, anche se è memorizzato
+ * con un layout permutato. Lo stato solo sparso viene stampato come elenco
+ * delle ampiezze non nulle.
+ */
+void circuit_fprint_state(FILE *out, const Circuit *c) {
+    if (!c->state.data) {
+        fprint_sparse_vector(out, &c->sparse, c->n_qubits);
+        return;
+    }
+    if (!c->layout) {
+        fprint_complex_vector(out, &c->state);
+        return;
+    }
+
+    ComplexVector logical = alloc_complex_vector(c->dim);
+    for (size_t i = 0; i < c->dim; i++) {
+        size_t p = 0;
+        for (unsigned int q = 0; q < c->n_qubits; q++)
+            if (i & ((size_t)1 << q)) p |= (size_t)1 << c->layout[q];
+        logical.data[i] = c->state.data[p];
+    }
+    fprint_complex_vector(out, &logical);
+    free_complex_vector(&logical);
 }
 
 void circuit_print_gate(const Circuit *c, size_t index) {
     if (index >= c->gate_count) return;
-    printf("Gate %s:\n", c->gates[index].name);
-    print_complex_matrix(&c->gates[index].matrix);
+    const Gate *g = &c->gates[index];
+    printf("Gate %s:\n", g->name);
+    if (g->matrix.data) {
+        print_complex_matrix(&g->matrix);
+        return;
+    }
+    // Gate con la sola matrice locale: qubit del supporto e matrice 2^k x 2^k
+    printf("on");
+    for (unsigned int b = 0; b < g->support_len; b++) printf(" %u", g->support[b]);
+    printf("\n");
+    print_complex_matrix(&g->local);
 }
 
@@ -4,47 +4,201 @@
 #include <stddef.h>
 #include "complex_vector.h"
 #include "complex_matrix.h"
+#include "threadpool.h"
+#include "transform.h"
+#include "sparse_vector.h"
 
 
 // Macro per accedere agli elementi di una matrice complessa
 #define MAT(m, i, j) ((m)->data[(i) * (m)->cols + (j)])
 
 
+// Numero massimo di qubit su cui un gate può agire per essere applicato come gate locale
+#define GATE_LOCAL_MAX_QUBITS 4
+
+// Registri più grandi non allocano lo stato denso: lo stato è solo sparso
+#define CIRCUIT_DENSE_MAX_QUBITS 26
+
+// Oltre questa soglia i gate definiti sui soli qubit su cui agiscono non possono avere matrice densa
+#define GATE_DENSE_MAX_QUBITS 12
+
+
 /*
  * Rappresenta una porta quantistica:
- * - name   : nome simbolico del gate
- * - matrix : matrice complessa 2^n x 2^n associata al gate
+ * - name    : nome simbolico del gate
+ * - matrix  : matrice complessa 2^n x 2^n associata al gate; assente
+ *             (data == NULL) per i gate locali definiti con
+ *             circuit_add_local_gate finché non serve (circuit_gate_matrix)
+ * - sparse  : copia CSR della matrice, costruita solo se serve al kernel sparso
+ * - analyzed: la località del gate è già stata analizzata (vedi sotto)
+ * - support : qubit (logici, in ordine crescente) su cui il gate agisce in
+ *             modo non banale; valido solo se local.data != NULL
+ * - local   : matrice 2^k x 2^k ristretta ai k qubit del supporto, presente
+ *             solo se k <= GATE_LOCAL_MAX_QUBITS
+ * - transform, reverse_in, reverse_out: trasformata riconosciuta dal parser
+ *             (vedi transform_detect), applicata con il kernel FFT/FWHT
  */
 typedef struct {
     char *name;
     ComplexMatrix matrix;
+    SparseComplexMatrix sparse;
+    int analyzed;
+    unsigned int support_len;
+    unsigned int support[GATE_LOCAL_MAX_QUBITS];
+    ComplexMatrix local;
+    TransformKind transform;
+    int reverse_in;
+    int reverse_out;
 } Gate;
 
+/*
+ * Kernel disponibili per il prodotto gate-stato:
+ * - KERNEL_DENSE  : prodotto riga per colonna sulla matrice densa
+ * - KERNEL_SPARSE : prodotto sui soli elementi non nulli (formato CSR)
+ * - KERNEL_LOCAL  : i gate che agiscono su pochi qubit vengono applicati con
+ *                   la sola matrice locale, con rimappatura dei qubit (gli
+ *                   altri gate usano il prodotto denso)
+ */
+typedef enum {
+    KERNEL_DENSE = 0,
+    KERNEL_SPARSE = 1,
+    KERNEL_LOCAL = 2
+} KernelKind;
+
+/*
+ * Configurazione di esecuzione (scelta a mano o dall'autotuner):
+ * - n_threads : dimensione del pool
+ * - chunk     : righe per blocco assegnato ai thread (0 = un blocco per thread)
+ * - kernel    : variante del prodotto gate-stato
+ */
+typedef struct {
+    size_t n_threads;
+    size_t chunk;
+    KernelKind kernel;
+} ExecConfig;
+
+/*
+ * Canali di rumore applicabili dopo ogni gate della sequenza:
+ * - NOISE_DEPOLARIZING : con probabilità param applica X, Y o Z a ogni qubit
+ * - NOISE_DAMPING      : amplitude damping con probabilità param su ogni qubit
+ * - NOISE_KRAUS        : canale generico sull'intero registro, i cui operatori
+ *                        di Kraus sono gate definiti con #define
+ */
+typedef enum {
+    NOISE_DEPOLARIZING,
+    NOISE_DAMPING,
+    NOISE_KRAUS
+} NoiseKind;
+
+typedef struct {
+    NoiseKind kind;
+    double param;            /* probabilità (depolarizing, damping) */
+    size_t *kraus;           /* indici dei gate usati come operatori di Kraus */
+    size_t kraus_count;
+} NoiseChannel;
+
+/*
+ * Rotazioni a un qubit usate dai gate parametrici (#param):
+ * RX, RY, RZ di angolo theta e PHASE = diag(1, e^{i theta}).
+ */
+typedef enum {
+    ROT_X,
+    ROT_Y,
+    ROT_Z,
+    ROT_PHASE
+} RotationKind;
+
+/*
+ * Gate parametrico: la matrice locale del gate 'gate' viene aggiornata come
+ * rotazione 'kind' sul qubit 'qubit' ogni volta che cambia il parametro 'param'.
+ */
+typedef struct {
+    size_t gate;
+    RotationKind kind;
+    unsigned int qubit;
+    size_t param;
+} ParamGate;
+
+/*
+ * Blocco #repeat: le posizioni [start, start + len) della sequenza vanno
+ * ripetute count volte. I blocchi possono essere annidati; vengono risolti
+ * da circuit_expand_repeats prima dell'esecuzione.
+ */
+typedef struct {
+    size_t start;
+    size_t len;
+    size_t count;
+} RepeatBlock;
+
 /*
  * Rappresenta un circuito quantistico a n qubits.
+ * Il qubit q corrisponde al bit q dell'indice della base (qubit 0 = bit meno significativo).
+ * Durante l'esecuzione con KERNEL_LOCAL lo stato può essere memorizzato con i
+ * qubit permutati: layout[q] è il bit fisico del qubit logico q (NULL = identità).
+ * Gli esecutori ripristinano l'ordine logico prima di terminare.
+ * Oltre CIRCUIT_DENSE_MAX_QUBITS qubit lo stato denso non viene allocato
+ * (state.data == NULL) e le ampiezze non nulle sono in 'sparse'.
  */
 typedef struct {
     unsigned int n_qubits;   /* numero di qubits */
     size_t dim;              /* dimensione spazio: 2^n */
 
     ComplexVector state;     /* stato corrente */
+    unsigned int *layout;    /* permutazione logico -> fisico dei qubit (NULL = identità) */
+    SparseVector sparse;     /* stato sparso (solo se state.data == NULL) */
 
     Gate *gates;             /* array dei gate definiti */
     size_t gate_count;
 
     size_t *sequence;        /* sequenza di applicazione */
     size_t sequence_len;
+
+    RepeatBlock *repeats;    /* blocchi #repeat non ancora espansi */
+    size_t repeat_count;
+
+    NoiseChannel *noise;     /* canali di rumore (solo simulazione a traiettorie) */
+    size_t noise_count;
+
+    char **params;           /* nomi dei parametri dei gate parametrici */
+    double *param_values;    /* valori correnti dei parametri */
+    size_t param_count;
+
+    ParamGate *param_gates;  /* gate la cui matrice dipende da un parametro */
+    size_t param_gate_count;
 } Circuit;
 
 /* Inizializzazione e gestione */
 void circuit_init(Circuit *c, unsigned int n_qubits);
+void circuit_init_template(Circuit *c, unsigned int n_qubits);
 void circuit_add_gate(Circuit *c, const char *name, ComplexMatrix matrix);
+void circuit_add_local_gate(Circuit *c, const char *name, const unsigned int *qubits,
+                            unsigned int k, ComplexMatrix local);
+const ComplexMatrix *circuit_gate_matrix(Circuit *c, size_t gate);
+unsigned int gate_support_union(const Gate *g, unsigned int *u, unsigned int ulen);
+ComplexMatrix gate_local_on(const Gate *g, const unsigned int *u, unsigned int ulen);
 void circuit_set_sequence(Circuit *c, const size_t *sequence, size_t length);
-void circuit_execute_parallel(Circuit *c, size_t n_threads);
+void circuit_append_sequence(Circuit *c, const size_t *sequence, size_t length);
+void circuit_add_repeat(Circuit *c, RepeatBlock block);
+void circuit_add_noise(Circuit *c, NoiseChannel channel);
+
+/* Gate parametrici */
+size_t circuit_find_param(const Circuit *c, const char *name);
+size_t circuit_add_param(Circuit *c, const char *name);
+void circuit_add_param_gate(Circuit *c, const char *name, RotationKind kind,
+                            unsigned int qubit, size_t param);
+void circuit_set_param(Circuit *c, size_t param, double value);
+
+/* Esecuzione */
+void circuit_analyze_gate(Circuit *c, size_t gate);
+void circuit_execute_pool(Circuit *c, ThreadPool *pool, ComplexVector *scratch);
+void circuit_execute_serial(Circuit *c, ComplexVector *scratch);
+void circuit_execute_config(Circuit *c, ThreadPool *pool, size_t chunk,
+                            KernelKind kernel, ComplexVector *scratch);
 void circuit_free(Circuit *c);
 
 /* Debug / Output */
 void circuit_print_state(const Circuit *c);
+void circuit_fprint_state(FILE *out, const Circuit *c);
 void circuit_print_gate(const Circuit *c, size_t gate_index);
 void circuit_print_all_gates(const Circuit *c);
 
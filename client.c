@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_LINE 4096
+
+/**
+ * Client minimale per il server del simulatore (quantum_sim --serve).
+ * Invia il comando passato come argomenti, oppure le righe lette da
+ * standard input, e stampa le risposte del server.
+ *
+ * Esempi:
+ *   quantum_client -s /tmp/qsim.sock RUN test/H2-init.q test/H2-circ.q
+ *   quantum_client -s /tmp/qsim.sock STATS
+ */
+int main(int argc, char *argv[]) {
+    char *socket_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+s:")) != -1) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            default:
+                fprintf(stderr, "Uso: %s -s socket [COMANDO ARGOMENTI...]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!socket_path) {
+        fprintf(stderr, "Uso: %s -s socket [COMANDO ARGOMENTI...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Errore: percorso del socket troppo lungo\n");
+        return EXIT_FAILURE;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Errore socket");
+        return EXIT_FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("Errore connect");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = fdopen(dup(fd), "w");
+    if (!out) {
+        perror("Errore fdopen");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // Comando da riga di comando oppure righe da standard input
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++)
+            fprintf(out, "%s%c", argv[i], (i + 1 < argc) ? ' ' : '\n');
+    } else {
+        char line[MAX_LINE];
+        while (fgets(line, sizeof(line), stdin))
+            fputs(line, out);
+    }
+    fclose(out);
+    // Segnala la fine dei comandi: il server chiude dopo aver risposto
+    shutdown(fd, SHUT_WR);
+
+    FILE *in = fdopen(fd, "r");
+    if (!in) {
+        perror("Errore fdopen");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, in) != -1) {
+        if (strncmp(line, "ERR", 3) == 0) status = EXIT_FAILURE;
+        fputs(line, stdout);
+    }
+    free(line);
+    fclose(in);
+
+    return status;
+}
@@ -0,0 +1,391 @@
+#define _POSIX_C_SOURCE 200809L
+#include "codegen.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Versione del formato della libreria generata (entra nell'hash)
+#define CODEGEN_ABI 1
+#define PATH_LEN 1024
+
+
+/* HASH DEL CIRCUITO */
+
+static uint64_t fnv_update(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Hash di tutto ciò che determina il codice generato: numero di qubit,
+ * sequenza e, per ogni gate locale, supporto e coefficienti della matrice locale.
+ * La libreria è compilata con -march=native, quindi entrano nell'hash anche
+ * l'host (come per il file di autotune) e il compilatore: una cache condivisa
+ * tra macchine diverse non carica codice per un'altra CPU.
+ */
+static uint64_t circuit_hash(Circuit *c, const char *cc) {
+    uint64_t h = 1469598103934665603ULL;
+    unsigned int abi = CODEGEN_ABI;
+    h = fnv_update(h, &abi, sizeof(abi));
+
+    char host[256];
+    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+    h = fnv_update(h, host, strlen(host) + 1);
+    h = fnv_update(h, cc, strlen(cc) + 1);
+
+    h = fnv_update(h, &c->n_qubits, sizeof(c->n_qubits));
+    h = fnv_update(h, &c->sequence_len, sizeof(c->sequence_len));
+
+    for (size_t s = 0; s < c->sequence_len; s++) {
+        size_t gi = c->sequence[s];
+        circuit_analyze_gate(c, gi);
+        const Gate *g = &c->gates[gi];
+        h = fnv_update(h, &gi, sizeof(gi));
+        if (!g->local.data) continue;
+        h = fnv_update(h, &g->support_len, sizeof(g->support_len));
+        h = fnv_update(h, g->support, g->support_len * sizeof(unsigned int));
+        h = fnv_update(h, g->local.data, g->local.rows * g->local.cols * sizeof(Complex));
+    }
+    return h;
+}
+
+
+/* GENERAZIONE DEL SORGENTE */
+
+/* Termine di una somma generata: coefficiente costante per variabile */
+typedef struct {
+    double coef;
+    char var[24];
+} Term;
+
+static void add_term(Term *terms, size_t *n, double coef, char kind, size_t index) {
+    if (coef == 0.0) return;
+    terms[*n].coef = coef;
+    snprintf(terms[*n].var, sizeof(terms[*n].var), "%c%zu", kind, index);
+    (*n)++;
+}
+
+/**
+ * Scrive la somma dei termini raccogliendo i coefficienti con lo stesso
+ * modulo: ad esempio 0.7071 * (r0 - r1) invece di due prodotti; i
+ * coefficienti ±1 non generano moltiplicazioni.
+ */
+static void emit_sum(FILE *out, Term *terms, size_t n) {
+    if (n == 0) {
+        fprintf(out, "0.0");
+        return;
+    }
+
+    int done[2 * (1 << GATE_LOCAL_MAX_QUBITS)] = {0};
+    int first_group = 1;
+    for (size_t t = 0; t < n; t++) {
+        if (done[t]) continue;
+        double k = fabs(terms[t].coef);
+
+        if (!first_group) fprintf(out, " + ");
+        first_group = 0;
+        if (k != 1.0) fprintf(out, "%.17g * ", k);
+        fprintf(out, "(");
+
+        int first = 1;
+        for (size_t u = t; u < n; u++) {
+            if (done[u] || fabs(terms[u].coef) != k) continue;
+            done[u] = 1;
+            if (terms[u].coef < 0)
+                fprintf(out, first ? "-%s" : " - %s", terms[u].var);
+            else
+                fprintf(out, first ? "%s" : " + %s", terms[u].var);
+            first = 0;
+        }
+        fprintf(out, ")");
+    }
+}
+
+/* Verifica se la riga r della matrice locale è la riga dell'identità */
+static int identity_row(const ComplexMatrix *m, size_t r) {
+    for (size_t l = 0; l < m->cols; l++) {
+        Complex z = MAT(m, r, l);
+        if (z.imag != 0.0 || z.real != (l == r ? 1.0 : 0.0)) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Genera il kernel di un gate locale: passi e offset costanti, prodotto
+ * 2^k x 2^k srotolato con coefficienti costanti; le righe identità non
+ * vengono né calcolate né scritte.
+ * Output: numero di righe non banali (0 se il gate è l'identità)
+ */
+static size_t emit_gate(FILE *out, const Gate *g, size_t index) {
+    const ComplexMatrix *m = &g->local;
+    size_t kdim = m->rows;
+    unsigned int k = g->support_len;
+
+    size_t active = 0;
+    for (size_t r = 0; r < kdim; r++)
+        if (!identity_row(m, r)) active++;
+    if (active == 0) return 0;
+
+    // Il supporto è in ordine crescente: l'indice base si ottiene inserendo
+    // uno zero in ogni suo bit, dal più basso
+    const unsigned int *bits = g->support;
+
+    fprintf(out, "/* gate %s */\n", g->name);
+    fprintf(out, "static void gate_%zu(double *restrict s, size_t begin, size_t end) {\n", index);
+    fprintf(out, "    for (size_t g = begin; g < end; g++) {\n");
+    fprintf(out, "        size_t b = g;\n");
+    for (unsigned int i = 0; i < k; i++) {
+        size_t low = ((size_t)1 << bits[i]) - 1;
+        if (low == 0)
+            fprintf(out, "        b <<= 1;\n");
+        else
+            fprintf(out, "        b = ((b & ~(size_t)0x%zx) << 1) | (b & (size_t)0x%zx);\n", low, low);
+    }
+
+    for (size_t l = 0; l < kdim; l++) {
+        size_t off = 0;
+        for (unsigned int i = 0; i < k; i++)
+            if (l & ((size_t)1 << i)) off |= (size_t)1 << g->support[i];
+        fprintf(out, "        double *p%zu = s + 2 * (b + %zu);\n", l, off);
+        fprintf(out, "        const double r%zu = p%zu[0], i%zu = p%zu[1];\n", l, l, l, l);
+    }
+
+    Term terms[2 * (1 << GATE_LOCAL_MAX_QUBITS)];
+    for (size_t r = 0; r < kdim; r++) {
+        if (identity_row(m, r)) continue;
+
+        // Re(out) = Σ a*re - b*im, Im(out) = Σ a*im + b*re
+        size_t n = 0;
+        for (size_t l = 0; l < kdim; l++) {
+            add_term(terms, &n, MAT(m, r, l).real, 'r', l);
+            add_term(terms, &n, -MAT(m, r, l).imag, 'i', l);
+        }
+        fprintf(out, "        p%zu[0] = ", r);
+        emit_sum(out, terms, n);
+        fprintf(out, ";\n");
+
+        n = 0;
+        for (size_t l = 0; l < kdim; l++) {
+            add_term(terms, &n, MAT(m, r, l).real, 'i', l);
+            add_term(terms, &n, MAT(m, r, l).imag, 'r', l);
+        }
+        fprintf(out, "        p%zu[1] = ", r);
+        emit_sum(out, terms, n);
+        fprintf(out, ";\n");
+    }
+
+    fprintf(out, "    }\n}\n\n");
+    return active;
+}
+
+/**
+ * Scrive il sorgente completo: un kernel per ogni gate locale distinto usato
+ * nella sequenza e la tabella qsim_steps con un passo per elemento della sequenza.
+ */
+static int write_source(Circuit *c, const char *path, uint64_t hash) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+
+    fprintf(out, "/* Generato da quantum_sim: %u qubit, %zu gate nella sequenza */\n",
+            c->n_qubits, c->sequence_len);
+    fprintf(out, "#include <stddef.h>\n\n");
+    fprintf(out, "typedef struct {\n    void (*fn)(double *, size_t, size_t);\n    size_t items;\n} CodegenStep;\n\n");
+
+    // Un kernel per gate, generato alla prima occorrenza nella sequenza
+    char *emitted = calloc(c->gate_count, 1);
+    size_t *active = calloc(c->gate_count, sizeof(size_t));
+    if (!emitted || !active) {
+        perror("Errore calloc codegen");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t s = 0; s < c->sequence_len; s++) {
+        size_t gi = c->sequence[s];
+        if (emitted[gi] || !c->gates[gi].local.data) continue;
+        emitted[gi] = 1;
+        active[gi] = emit_gate(out, &c->gates[gi], gi);
+    }
+
+    fprintf(out, "const unsigned long long qsim_hash = 0x%" PRIx64 "ULL;\n", hash);
+    fprintf(out, "const size_t qsim_step_count = %zu;\n", c->sequence_len);
+    fprintf(out, "const CodegenStep qsim_steps[] = {\n");
+    for (size_t s = 0; s < c->sequence_len; s++) {
+        size_t gi = c->sequence[s];
+        const Gate *g = &c->gates[gi];
+        if (!g->local.data)
+            fprintf(out, "    {0, %zu},\n", c->dim);
+        else if (active[gi] == 0)
+            fprintf(out, "    {0, 0},\n");
+        else
+            fprintf(out, "    {gate_%zu, %zu},\n", gi, c->dim >> g->support_len);
+    }
+    if (c->sequence_len == 0) fprintf(out, "    {0, 0}\n");
+    fprintf(out, "};\n");
+
+    free(emitted);
+    free(active);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+
+/* COMPILAZIONE E CACHE */
+
+/* Directory della cache: $QSIM_CACHE_DIR oppure ~/.cache/quantum_sim (creata se manca) */
+static int cache_dir(char *buf, size_t size) {
+    const char *env = getenv("QSIM_CACHE_DIR");
+    if (env && *env) {
+        snprintf(buf, size, "%s", env);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home) home = ".";
+        snprintf(buf, size, "%s/.cache", home);
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) return -1;
+        snprintf(buf, size, "%s/.cache/quantum_sim", home);
+    }
+    if (mkdir(buf, 0755) != 0 && errno != EEXIST) return -1;
+    return 0;
+}
+
+/* Compilatore: $CC oppure "cc" */
+static const char *compiler(void) {
+    const char *cc = getenv("CC");
+    return cc && *cc ? cc : "cc";
+}
+
+/* Esegue il compilatore senza passare dalla shell */
+static int run_compiler(const char *cc, const char *src, const char *so) {
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execlp(cc, cc, "-O3", "-march=native", "-fPIC", "-shared", "-o", so, src, (char *)NULL);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/* Carica la libreria e ne verifica l'hash; 0 in caso di successo */
+static int open_library(const char *so, uint64_t hash, CompiledCircuit *out) {
+    void *handle = dlopen(so, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) return -1;
+
+    const unsigned long long *h = dlsym(handle, "qsim_hash");
+    const size_t *count = dlsym(handle, "qsim_step_count");
+    const CodegenStep *steps = dlsym(handle, "qsim_steps");
+    if (!h || !count || !steps || *h != hash) {
+        dlclose(handle);
+        return -1;
+    }
+
+    out->handle = handle;
+    out->steps = steps;
+    out->step_count = *count;
+    out->hash = hash;
+    return 0;
+}
+
+int codegen_load(Circuit *c, CompiledCircuit *out) {
+    memset(out, 0, sizeof(*out));
+
+    char dir[PATH_LEN];
+    if (cache_dir(dir, sizeof(dir)) != 0) {
+        fprintf(stderr, "Codegen: impossibile creare la directory di cache %s\n", dir);
+        return -1;
+    }
+
+    const char *cc = compiler();
+    uint64_t hash = circuit_hash(c, cc);
+    char so[PATH_LEN + 64], src[PATH_LEN + 64];
+    char tmp_src[PATH_LEN + 96], tmp_so[PATH_LEN + 96];
+    snprintf(so, sizeof(so), "%s/qsim_%016" PRIx64 ".so", dir, hash);
+
+    // Circuito già compilato: basta caricarlo
+    if (open_library(so, hash, out) == 0) return 0;
+
+    // Sorgente e libreria vengono scritti in file temporanei del processo e
+    // pubblicati con rename: altri processi non vedono mai file parziali
+    snprintf(src, sizeof(src), "%s/qsim_%016" PRIx64 ".c", dir, hash);
+    snprintf(tmp_src, sizeof(tmp_src), "%s/qsim_%016" PRIx64 ".%ld.tmp.c", dir, hash, (long)getpid());
+    snprintf(tmp_so, sizeof(tmp_so), "%s/qsim_%016" PRIx64 ".so.%ld.tmp", dir, hash, (long)getpid());
+    if (write_source(c, tmp_src, hash) != 0) {
+        fprintf(stderr, "Codegen: impossibile scrivere %s\n", tmp_src);
+        unlink(tmp_src);
+        return -1;
+    }
+    if (run_compiler(cc, tmp_src, tmp_so) != 0 || rename(tmp_so, so) != 0) {
+        fprintf(stderr, "Codegen: compilazione di %s fallita\n", tmp_src);
+        unlink(tmp_so);
+        unlink(tmp_src);
+        return -1;
+    }
+    // Il sorgente resta in cache accanto alla libreria
+    if (rename(tmp_src, src) != 0) unlink(tmp_src);
+    if (open_library(so, hash, out) != 0) {
+        fprintf(stderr, "Codegen: impossibile caricare %s\n", so);
+        return -1;
+    }
+    fprintf(stderr, "Codegen: compilato %s\n", so);
+    return 0;
+}
+
+
+/* ESECUZIONE */
+
+typedef struct {
+    void (*fn)(double *, size_t, size_t);
+    double *state;
+} StepTask;
+
+static void pool_step(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const StepTask *task = (const StepTask *)arg;
+    task->fn(task->state, begin, end);
+}
+
+void codegen_execute(Circuit *c, const CompiledCircuit *cc, ThreadPool *pool,
+                     ComplexVector *scratch) {
+    ComplexVector local = {NULL, 0};
+    if (!scratch) {
+        local = alloc_complex_vector(c->dim);
+        scratch = &local;
+    }
+
+    for (size_t s = 0; s < cc->step_count; s++) {
+        const CodegenStep *step = &cc->steps[s];
+        if (step->fn) {
+            // Complex è una coppia di double (real, imag): lo stato è già interleaved
+            StepTask task = {step->fn, (double *)c->state.data};
+            threadpool_run(pool, pool_step, &task, step->items, 0);
+        } else if (step->items > 0) {
+            // Gate non locale: kernel sparso generico su una vista di un solo gate
+            Circuit view = *c;
+            view.sequence = c->sequence + s;
+            view.sequence_len = 1;
+            circuit_execute_config(&view, pool, 0, KERNEL_SPARSE, scratch);
+            c->state = view.state;
+        }
+    }
+
+    free_complex_vector(&local);
+}
+
+void codegen_unload(CompiledCircuit *cc) {
+    if (cc->handle) dlclose(cc->handle);
+    memset(cc, 0, sizeof(*cc));
+}
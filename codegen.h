@@ -0,0 +1,55 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <stdint.h>
+#include "circuit.h"
+
+/*
+ * Passo di un circuito compilato, esportato dalla libreria generata:
+ * - fn    : kernel specializzato che aggiorna in place i gruppi [begin, end)
+ *           dello stato (ampiezze come coppie di double re, im);
+ *           NULL se il gate non è locale e va applicato dal kernel generico
+ * - items : numero di gruppi da distribuire tra i thread
+ */
+typedef struct {
+    void (*fn)(double *state, size_t begin, size_t end);
+    size_t items;
+} CodegenStep;
+
+/*
+ * Circuito compilato e caricato con dlopen: un passo per ogni elemento
+ * della sequenza #circ.
+ */
+typedef struct {
+    void *handle;
+    const CodegenStep *steps;
+    size_t step_count;
+    uint64_t hash;
+} CompiledCircuit;
+
+/**
+ * Genera il sorgente C specializzato per la sequenza del circuito, lo compila
+ * in una libreria condivisa e la carica. Le librerie sono conservate in
+ * $QSIM_CACHE_DIR (default ~/.cache/quantum_sim) con nome dato dall'hash del
+ * circuito, dell'host e del compilatore: un circuito già compilato sulla stessa
+ * macchina viene solo caricato.
+ * Il compilatore è $CC (default "cc").
+ * Input: c (circuito), out (struttura da riempire)
+ * Output: 0 in caso di successo, -1 se la compilazione o il caricamento falliscono
+ */
+int codegen_load(Circuit *c, CompiledCircuit *out);
+
+/**
+ * Esegue il circuito compilato sullo stato di c. I gate non locali vengono
+ * applicati con il kernel sparso generico; scratch ha la stessa semantica di
+ * circuit_execute_pool.
+ */
+void codegen_execute(Circuit *c, const CompiledCircuit *cc, ThreadPool *pool,
+                     ComplexVector *scratch);
+
+/**
+ * Scarica la libreria del circuito compilato.
+ */
+void codegen_unload(CompiledCircuit *cc);
+
+#endif
@@ -24,11 +24,15 @@ double complex_mod(Complex a) {
 }
 
 void print_complex(Complex c) {
+    fprint_complex(stdout, c);
+}
+
+void fprint_complex(FILE *out, Complex c) {
     // Gestione del segno della parte immaginaria
     if (c.imag < 0) {
-        printf("%.5f - i%.5f", c.real, -c.imag);
+        fprintf(out, "%.5f - i%.5f", c.real, -c.imag);
     } else {
-        printf("%.5f + i%.5f", c.real, c.imag);
+        fprintf(out, "%.5f + i%.5f", c.real, c.imag);
     }
 }
 
@@ -1,6 +1,8 @@
 #ifndef COMPLEX_H
 #define COMPLEX_H
 
+#include <stdio.h>
+
 #define EPSILON 1e-9
 
 /**
@@ -44,6 +46,12 @@ double complex_mod(Complex a);
  */
 void print_complex(Complex c);
 
+/**
+ * Come print_complex, ma scrive sullo stream indicato.
+ * Input: out (FILE*), c (Complex)
+ */
+void fprint_complex(FILE *out, Complex c);
+
 /**
  * Confronta due numeri complessi con una tolleranza epsilon.
  * Input: a, b (Complex), eps (double)
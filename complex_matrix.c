@@ -1,11 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h> // Per memcpy
 #include "complex_matrix.h"
 
 /* Macro per l'indicizzazione 2D in array 1D: (riga * num_colonne + colonna) */
 #define MAT(m, i, j) ((m)->data[(i) * (m)->cols + (j)])
 
+/* Lato dei blocchi per il prodotto matriciale parallelo (righe/colonne) */
+#define MUL_BLOCK 64
+
+/* Intestazione del formato binario delle matrici */
+#define BINARY_MAGIC "QSIMMAT1"
+
 ComplexMatrix alloc_complex_matrix(size_t rows, size_t cols) {
     ComplexMatrix matrix;
     matrix.rows = rows;
@@ -39,6 +46,52 @@ ComplexMatrix copy_complex_matrix(const ComplexMatrix *src) {
     return copy;
 }
 
+SparseComplexMatrix sparse_from_matrix(const ComplexMatrix *m) {
+    const Complex zero = {0.0, 0.0};
+    SparseComplexMatrix s;
+    s.rows = m->rows;
+    s.cols = m->cols;
+
+    // Primo passaggio: conteggio degli elementi non nulli
+    s.nnz = 0;
+    for (size_t k = 0; k < m->rows * m->cols; k++)
+        if (!complex_equal(m->data[k], zero, EPSILON)) s.nnz++;
+
+    s.row_ptr = malloc((m->rows + 1) * sizeof(size_t));
+    s.col_idx = malloc((s.nnz ? s.nnz : 1) * sizeof(size_t));
+    s.values = malloc((s.nnz ? s.nnz : 1) * sizeof(Complex));
+    if (!s.row_ptr || !s.col_idx || !s.values) {
+        fprintf(stderr, "FATAL: Out of memory allocating sparse matrix\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Secondo passaggio: copia degli elementi riga per riga
+    size_t k = 0;
+    for (size_t i = 0; i < m->rows; i++) {
+        s.row_ptr[i] = k;
+        for (size_t j = 0; j < m->cols; j++) {
+            if (complex_equal(MAT(m, i, j), zero, EPSILON)) continue;
+            s.col_idx[k] = j;
+            s.values[k] = MAT(m, i, j);
+            k++;
+        }
+    }
+    s.row_ptr[m->rows] = k;
+    return s;
+}
+
+void free_sparse_matrix(SparseComplexMatrix *s) {
+    if (!s || !s->row_ptr) return;
+
+    free(s->row_ptr);
+    free(s->col_idx);
+    free(s->values);
+    s->row_ptr = NULL;
+    s->col_idx = NULL;
+    s->values = NULL;
+    s->rows = s->cols = s->nnz = 0;
+}
+
 ComplexMatrix matrix_mul(const ComplexMatrix *a, const ComplexMatrix *b) {
     // Controllo coerenza dimensionale per prodotto matriciale
     if (a->cols != b->rows) {
@@ -62,6 +115,60 @@ ComplexMatrix matrix_mul(const ComplexMatrix *a, const ComplexMatrix *b) {
     return result;
 }
 
+/**
+ * Dati condivisi dai worker del prodotto a blocchi.
+ */
+typedef struct {
+    const ComplexMatrix *a;
+    const ComplexMatrix *b;
+    ComplexMatrix *result;
+} MulTask;
+
+/**
+ * Calcola le righe [begin, end) del risultato. L'ordine i-k-j a blocchi
+ * mantiene in cache un blocco di B e scorre le righe di B in modo contiguo,
+ * invece di leggerne le colonne con passo cols come in matrix_mul.
+ */
+static void mul_rows(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const MulTask *t = (const MulTask *)arg;
+    const ComplexMatrix *a = t->a;
+    const ComplexMatrix *b = t->b;
+    ComplexMatrix *r = t->result;
+
+    for (size_t kb = 0; kb < a->cols; kb += MUL_BLOCK) {
+        size_t k_end = kb + MUL_BLOCK < a->cols ? kb + MUL_BLOCK : a->cols;
+        for (size_t jb = 0; jb < b->cols; jb += MUL_BLOCK) {
+            size_t j_end = jb + MUL_BLOCK < b->cols ? jb + MUL_BLOCK : b->cols;
+            for (size_t i = begin; i < end; i++) {
+                for (size_t k = kb; k < k_end; k++) {
+                    Complex aik = MAT(a, i, k);
+                    if (aik.real == 0.0 && aik.imag == 0.0) continue;
+                    for (size_t j = jb; j < j_end; j++)
+                        MAT(r, i, j) = complex_add(MAT(r, i, j), complex_mul(aik, MAT(b, k, j)));
+                }
+            }
+        }
+    }
+}
+
+ComplexMatrix matrix_mul_parallel(const ComplexMatrix *a, const ComplexMatrix *b, ThreadPool *pool) {
+    if (a->cols != b->rows) {
+        fprintf(stderr, "Error: incompatible matrix dimensions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // alloc_complex_matrix azzera il risultato, che viene accumulato
+    ComplexMatrix result = alloc_complex_matrix(a->rows, b->cols);
+    MulTask task = {a, b, &result};
+
+    // Blocchi di MUL_BLOCK righe, assegnati dinamicamente
+    size_t chunk = a->rows / pool->n_threads;
+    if (chunk > MUL_BLOCK) chunk = MUL_BLOCK;
+    threadpool_run(pool, mul_rows, &task, a->rows, chunk ? chunk : 1);
+    return result;
+}
+
 ComplexVector matrix_vector_mul(const ComplexMatrix *a, const ComplexVector *v) {
     // Controllo che il numero di colonne della matrice sia uguale alla dimensione del vettore
     if (a->cols != v->size) {
@@ -70,6 +177,15 @@ ComplexVector matrix_vector_mul(const ComplexMatrix *a, const ComplexVector *v)
     }
 
     ComplexVector result = alloc_complex_vector(a->rows);
+    matrix_vector_mul_into(a, v, &result);
+    return result;
+}
+
+void matrix_vector_mul_into(const ComplexMatrix *a, const ComplexVector *v, ComplexVector *out) {
+    if (a->cols != v->size || a->rows != out->size) {
+        fprintf(stderr, "Error: incompatible matrix/vector dimensions\n");
+        exit(EXIT_FAILURE);
+    }
 
     for (size_t i = 0; i < a->rows; i++) {
         Complex sum = {0.0, 0.0};
@@ -78,9 +194,36 @@ ComplexVector matrix_vector_mul(const ComplexMatrix *a, const ComplexVector *v)
             Complex prod = complex_mul(MAT(a, i, j), v->data[j]);
             sum = complex_add(sum, prod);
         }
-        result.data[i] = sum;
+        out->data[i] = sum;
     }
-    return result;
+}
+
+int write_complex_matrix_binary(FILE *out, const ComplexMatrix *matrix) {
+    uint64_t dims[2] = {matrix->rows, matrix->cols};
+    size_t count = matrix->rows * matrix->cols;
+
+    if (fwrite(BINARY_MAGIC, 1, 8, out) != 8) return -1;
+    if (fwrite(dims, sizeof(uint64_t), 2, out) != 2) return -1;
+    // Complex è una coppia di double contigui: si scrive l'array così com'è
+    if (fwrite(matrix->data, sizeof(Complex), count, out) != count) return -1;
+    return 0;
+}
+
+int read_complex_matrix_binary(FILE *in, ComplexMatrix *matrix) {
+    char magic[8];
+    uint64_t dims[2];
+
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, BINARY_MAGIC, 8) != 0) return -1;
+    if (fread(dims, sizeof(uint64_t), 2, in) != 2) return -1;
+    if (dims[0] == 0 || dims[1] == 0 || dims[0] > SIZE_MAX / sizeof(Complex) / dims[1]) return -1;
+
+    *matrix = alloc_complex_matrix(dims[0], dims[1]);
+    size_t count = matrix->rows * matrix->cols;
+    if (fread(matrix->data, sizeof(Complex), count, in) != count) {
+        free_complex_matrix(matrix);
+        return -1;
+    }
+    return 0;
 }
 
 void print_complex_matrix(const ComplexMatrix *matrix) {
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include "complex.h"
 #include "complex_vector.h"
+#include "threadpool.h"
 
 /**
  * Struttura per rappresentare una matrice di numeri complessi.
@@ -16,6 +17,19 @@ typedef struct {
     Complex *data;
 } ComplexMatrix;
 
+/**
+ * Matrice in formato sparso CSR (Compressed Sparse Row): per ogni riga i gli
+ * elementi non nulli sono values[row_ptr[i] .. row_ptr[i+1]) nelle colonne col_idx.
+ */
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t nnz;          /* numero di elementi non nulli */
+    size_t *row_ptr;     /* rows + 1 elementi */
+    size_t *col_idx;
+    Complex *values;
+} SparseComplexMatrix;
+
 /**
  * Alloca memoria per una matrice di dimensioni specificate.
  * Input: rows, cols (size_t)
@@ -29,6 +43,20 @@ ComplexMatrix alloc_complex_matrix(size_t rows, size_t cols);
  */
 void free_complex_matrix(ComplexMatrix* matrix);
 
+/**
+ * Converte una matrice densa in formato CSR, scartando gli elementi
+ * nulli entro la tolleranza EPSILON.
+ * Input: m (matrice densa)
+ * Output: SparseComplexMatrix
+ */
+SparseComplexMatrix sparse_from_matrix(const ComplexMatrix *m);
+
+/**
+ * Libera la memoria di una matrice CSR.
+ * Input: s (puntatore a SparseComplexMatrix)
+ */
+void free_sparse_matrix(SparseComplexMatrix *s);
+
 /* Operazioni Matematiche */
 
 /**
@@ -38,6 +66,14 @@ void free_complex_matrix(ComplexMatrix* matrix);
  */
 ComplexMatrix matrix_mul(const ComplexMatrix *a, const ComplexMatrix *b);
 
+/**
+ * Prodotto tra matrici a blocchi, con i blocchi di righe del risultato
+ * distribuiti tra i worker del pool.
+ * Input: a, b (matrici), pool (thread pool)
+ * Output: ComplexMatrix risultato
+ */
+ComplexMatrix matrix_mul_parallel(const ComplexMatrix *a, const ComplexMatrix *b, ThreadPool *pool);
+
 /**
  * Moltiplica una matrice per un vettore colonna.
  * Input: a (matrice), v (vettore)
@@ -45,6 +81,13 @@ ComplexMatrix matrix_mul(const ComplexMatrix *a, const ComplexMatrix *b);
  */
 ComplexVector matrix_vector_mul(const ComplexMatrix *a, const ComplexVector *v);
 
+/**
+ * Come matrix_vector_mul, ma scrive il risultato in un vettore già allocato
+ * (out deve avere dimensione a->rows e non coincidere con v).
+ * Input: a (matrice), v (vettore), out (vettore risultato)
+ */
+void matrix_vector_mul_into(const ComplexMatrix *a, const ComplexVector *v, ComplexVector *out);
+
 /**
  * Crea una copia esatta della matrice sorgente in una nuova zona di memoria.
  * Input: src (matrice sorgente)
@@ -52,6 +95,21 @@ ComplexVector matrix_vector_mul(const ComplexMatrix *a, const ComplexVector *v);
  */
 ComplexMatrix copy_complex_matrix(const ComplexMatrix *src);
 
+/**
+ * Scrive la matrice in formato binario: intestazione "QSIMMAT1", righe e
+ * colonne (uint64), poi gli elementi come coppie di double in ordine di riga.
+ * Input: out (stream aperto in scrittura binaria), matrix
+ * Output: 0 in caso di successo, -1 in caso di errore di scrittura
+ */
+int write_complex_matrix_binary(FILE *out, const ComplexMatrix *matrix);
+
+/**
+ * Legge una matrice scritta da write_complex_matrix_binary.
+ * Input: in (stream aperto in lettura binaria), matrix (output)
+ * Output: 0 in caso di successo, -1 se il formato non è valido
+ */
+int read_complex_matrix_binary(FILE *in, ComplexMatrix *matrix);
+
 /**
  * Stampa la matrice a terminale (debug).
  * Input: matrix (puntatore a ComplexMatrix costante)
@@ -34,18 +34,29 @@ void zero_complex_vector(ComplexVector* vector) {
     memset(vector->data, 0, vector->size * sizeof(Complex));
 }
 
+void scale_complex_vector(ComplexVector* vector, Complex factor) {
+    if (vector == NULL || vector->data == NULL) return;
+
+    for (size_t i = 0; i < vector->size; i++)
+        vector->data[i] = complex_mul(vector->data[i], factor);
+}
+
 void print_complex_vector(const ComplexVector* vector) {
+    fprint_complex_vector(stdout, vector);
+}
+
+void fprint_complex_vector(FILE *out, const ComplexVector* vector) {
     if (!vector || !vector->data) {
-        printf("[]\n");
+        fprintf(out, "[]\n");
         return;
     }
 
-    printf("[");
+    fprintf(out, "[");
     for (size_t i = 0; i < vector->size; i++) {
-        print_complex(vector->data[i]);
+        fprint_complex(out, vector->data[i]);
         // Aggiunge la virgola solo tra gli elementi, non dopo l'ultimo
         if (i + 1 < vector->size)
-            printf(", ");
+            fprintf(out, ", ");
     }
-    printf("]\n");
+    fprintf(out, "]\n");
 }
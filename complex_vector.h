@@ -2,6 +2,7 @@
 #define COMPLEX_VECTOR_H
 
 #include <stddef.h>
+#include <stdio.h>
 #include "complex.h"
 
 /**
@@ -33,10 +34,22 @@ void free_complex_vector(ComplexVector* vector);
  */
 void zero_complex_vector(ComplexVector* vector);
 
+/**
+ * Moltiplica tutti gli elementi del vettore per lo scalare indicato.
+ * Input: vector (puntatore al vettore), factor (scalare complesso)
+ */
+void scale_complex_vector(ComplexVector* vector, Complex factor);
+
 /**
  * Stampa il contenuto del vettore in formato leggibile.
  * Input: vector (puntatore costante al vettore da stampare)
  */
 void print_complex_vector(const ComplexVector* vector);
 
+/**
+ * Come print_complex_vector, ma scrive sullo stream indicato.
+ * Input: out (FILE*), vector (puntatore costante al vettore da stampare)
+ */
+void fprint_complex_vector(FILE *out, const ComplexVector* vector);
+
 #endif
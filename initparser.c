@@ -7,9 +7,9 @@
 
 #define MAX_LINE 4096 
 
-static void parse_error(const char *msg) {
+static int parse_error(const char *msg) {
     fprintf(stderr, "Init parser error: %s\n", msg);
-    exit(EXIT_FAILURE);
+    return -1;
 }
 
 // Rimuove spazi bianchi all'inizio e alla fine della stringa
@@ -49,15 +49,93 @@ static Complex parse_complex(const char *s) {
     return z;
 }
 
-void parse_init_file(const char *filename, Circuit *c) {
+/**
+ * Stato della base in notazione ket: #init |b_{n-1} ... b_1 b_0>
+ */
+static int read_ket(const char *ket, Circuit *c) {
+    const char *close = strchr(ket, '>');
+    if (!close) return parse_error("Invalid #init syntax: missing '>'");
+    if ((size_t)(close - ket - 1) != c->n_qubits) return parse_error("Wrong number of qubits in #init ket");
+    uint64_t k = 0;
+    for (const char *b = ket + 1; b < close; b++) {
+        if (*b != '0' && *b != '1') return parse_error("Invalid #init ket: expected 0 or 1");
+        k = (k << 1) | (uint64_t)(*b - '0');
+    }
+
+    Complex one = {1.0, 0.0};
+    if (c->state.data) {
+        zero_complex_vector(&c->state);
+        c->state.data[k] = one;
+    } else {
+        clear_sparse_vector(&c->sparse);
+        sparse_vector_add(&c->sparse, k, one);
+    }
+    return 0;
+}
+
+/**
+ * Vettore di stato esplicito "#init [a0, a1, ...]", anche su più righe.
+ */
+static int read_vector(const char *l, FILE *fp, Circuit *c) {
+    if (!c->state.data) return parse_error("Dense #init on too many qubits: use '#init |...>'");
+
+    // Individua l'inizio del vettore
+    const char *start = strchr(l, '[');
+    if (!start) return parse_error("Invalid #init syntax: missing '['");
+
+    size_t dim = c->dim;
+    // Allocazione dinamica del buffer di lettura per supportare H10 - test maledetto
+    size_t buffer_size = dim * 64 + MAX_LINE; 
+    char *buffer = malloc(buffer_size);
+    if (!buffer) return parse_error("Memory allocation failed");
+    size_t used = strlen(start);
+    if (used >= buffer_size) {
+        free(buffer);
+        return parse_error("#init vector too long");
+    }
+    memcpy(buffer, start, used + 1);
+
+    // Legge più righe finché non trova la chiusura ']'
+    char line[MAX_LINE];
+    while (!strchr(buffer, ']')) {
+        size_t n;
+        if (!fgets(line, sizeof(line), fp) || used + (n = strlen(line)) >= buffer_size) {
+            free(buffer);
+            return parse_error("Missing closing ] in #init");
+        }
+        memcpy(buffer + used, line, n + 1);
+        used += n;
+    }
+
+    char *p_open = buffer;
+    char *p_close = strchr(buffer, ']');
+    *p_close = '\0';
+
+    // Tokenizzazione dei valori separati da virgola
+    char *save = NULL;
+    char *tok = strtok_r(p_open + 1, ",", &save);
+    size_t idx = 0;
+
+    while (tok && idx < dim) {
+        c->state.data[idx++] = parse_complex(trim(tok));
+        tok = strtok_r(NULL, ",", &save);
+    }
+    free(buffer);
+
+    if (idx != dim || tok) return parse_error("Wrong number of init amplitudes");
+    return 0;
+}
+
+int parse_init_file(const char *filename, Circuit *c) {
     FILE *fp = fopen(filename, "r");
-    if (!fp) parse_error("Cannot open init file");
+    if (!fp) return parse_error("Cannot open init file");
 
     char line[MAX_LINE];
     int qubits_set = 0;
     int init_set   = 0;
+    int status     = 0;
 
-    while (fgets(line, sizeof(line), fp)) {
+    while (status == 0 && fgets(line, sizeof(line), fp)) {
         char *l = trim(line);
 
         // Ignora righe vuote e commenti che iniziano con %
@@ -66,61 +144,49 @@ void parse_init_file(const char *filename, Circuit *c) {
         /* Direttiva #qubits: definisce la dimensione del sistema */
         if (strncmp(l, "#qubits", 7) == 0) {
             unsigned int n;
-            if (sscanf(l, "#qubits %u", &n) != 1) parse_error("Invalid #qubits");
-            circuit_init(c, n);
-            qubits_set = 1;
+            if (qubits_set) status = parse_error("Duplicate #qubits");
+            else if (sscanf(l, "#qubits %u", &n) != 1) status = parse_error("Invalid #qubits");
+            else if (n >= 64) status = parse_error("Invalid #qubits: at most 63 qubits");
+            else {
+                circuit_init(c, n);
+                qubits_set = 1;
+            }
         }
-        /* Direttiva #init: legge il vettore di stato iniziale */
+        /* Direttiva #init: legge lo stato iniziale (ket o vettore) */
         else if (strncmp(l, "#init", 5) == 0) {
-            if (!qubits_set) parse_error("#init before #qubits");
-
-            size_t dim = 1UL << c->n_qubits;
-            // Allocazione dinamica del buffer di lettura per supportare H10 - test maledetto
-            size_t buffer_size = dim * 64 + MAX_LINE; 
-            char *buffer = malloc(buffer_size);
-            if (!buffer) parse_error("Memory allocation failed");
-            buffer[0] = '\0';
-
-            // Individua l'inizio del vettore
-            char *start = strchr(l, '[');
-            if (!start) parse_error("Invalid #init syntax: missing '['");
-            strcpy(buffer, start);
-
-            // Legge più righe finché non trova la chiusura ']'
-            while (!strchr(buffer, ']')) {
-                if (!fgets(line, sizeof(line), fp)) {
-                    free(buffer);
-                    parse_error("Missing closing ] in #init");
-                }
-                strcat(buffer, line);
-            }
-
-            char *p_open = strchr(buffer, '[');
-            char *p_close = strchr(buffer, ']');
-            size_t len = p_close - p_open - 1;
-
-            char *content = malloc(len + 1);
-            strncpy(content, p_open + 1, len);
-            content[len] = '\0';
-
-            // Tokenizzazione dei valori separati da virgola
-            char *tok = strtok(content, ",");
-            size_t idx = 0;
-
-            while (tok && idx < dim) {
-                c->state.data[idx++] = parse_complex(trim(tok));
-                tok = strtok(NULL, ",");
-            }
-
-            if (idx != dim) parse_error("Wrong number of init amplitudes");
-
-            free(buffer);
-            free(content);
+            if (!qubits_set) status = parse_error("#init before #qubits");
+            else if (strchr(l, '|')) status = read_ket(strchr(l, '|'), c);
+            else status = read_vector(l, fp, c);
             init_set = 1;
         }
         else {
-            parse_error("Unknown directive in init file");
+            status = parse_error("Unknown directive in init file");
         }
     }
     fclose(fp);
+
+    if (status == 0 && !qubits_set) status = parse_error("Missing #qubits");
+    else if (status == 0 && !init_set) status = parse_error("Missing #init");
+
+    // In caso di errore il circuito non resta allocato
+    if (status != 0 && qubits_set) circuit_free(c);
+    return status;
+}
+
+int parse_init_qubits(const char *filename, unsigned int *n_qubits) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) return -1;
+
+    // Legge solo le righe iniziali fino alla direttiva #qubits
+    char line[MAX_LINE];
+    int found = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        char *l = trim(line);
+        if (*l == '\0' || *l == '%') continue;
+        if (strncmp(l, "#qubits", 7) == 0 && sscanf(l, "#qubits %u", n_qubits) == 1)
+            found = 0;
+        break;
+    }
+    fclose(fp);
+    return found;
 }
\ No newline at end of file
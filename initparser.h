@@ -6,8 +6,19 @@
 /**
  * Legge il file di inizializzazione per configurare il sistema.
  * Gestisce le direttive #qubits e #init.
+ * Gli errori vengono segnalati su standard error; in caso di errore il
+ * circuito non resta allocato.
  * Input: filename, c (puntatore alla struttura Circuit)
+ * Output: 0 in caso di successo, -1 se il file non è valido
  */
-void parse_init_file(const char *filename, Circuit *c);
+int parse_init_file(const char *filename, Circuit *c);
+
+/**
+ * Legge solo la direttiva #qubits del file di inizializzazione, senza
+ * allocare lo stato (utile per stimare il costo di un job).
+ * Input: filename, n_qubits (output)
+ * Output: 0 se trovata, -1 altrimenti
+ */
+int parse_init_qubits(const char *filename, unsigned int *n_qubits);
 
 #endif
\ No newline at end of file
@@ -1,46 +1,269 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <getopt.h>
 #include "initparser.h"
 #include "circparser.h"
+#include "server.h"
+#include "batch.h"
+#include "autotune.h"
+#include "trajectories.h"
+#include "unitary.h"
+#include "sweep.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "repeat.h"
+#include "sparse_state.h"
+
+#define USAGE "Uso: %s -i init.q -c circ.q [-t threads|auto] [-O] [--trajectories N] [--seed S]\n" \
+              "        [--unitary file [--unitary-format text|bin]] [--sweep file] [--compile] [--sparse]\n" \
+              "     %s --serve socket [-t threads|auto]\n" \
+              "     %s --batch manifest [-t threads|auto]\n"
 
 /**
  * Punto di ingresso del simulatore.
- * Gestisce gli argomenti da riga di comando tramite getopt.
+ * Gestisce gli argomenti da riga di comando tramite getopt_long.
  */
 int main(int argc, char *argv[]) {
     char *init_file = NULL;
     char *circ_file = NULL;
+    char *socket_path = NULL;
+    char *manifest = NULL;
     int n_threads = 1;
+    int auto_threads = 0;
+    size_t n_trajectories = 0;
+    unsigned long long seed = 1;
+    char *unitary_file = NULL;
+    UnitaryFormat unitary_format = UNITARY_TEXT;
+    char *sweep_file = NULL;
+    int compile = 0;
+    int optimize = 0;
+    int sparse = 0;
+
+    static struct option long_options[] = {
+        {"serve", required_argument, NULL, 'S'},
+        {"batch", required_argument, NULL, 'B'},
+        {"trajectories", required_argument, NULL, 'N'},
+        {"seed", required_argument, NULL, 'R'},
+        {"unitary", required_argument, NULL, 'U'},
+        {"unitary-format", required_argument, NULL, 'F'},
+        {"sweep", required_argument, NULL, 'W'},
+        {"compile", no_argument, NULL, 'K'},
+        {"optimize", no_argument, NULL, 'O'},
+        {"sparse", no_argument, NULL, 'P'},
+        {NULL, 0, NULL, 0}
+    };
 
     int opt;
-    // Parsing delle opzioni: -i (input init), -c (input circuito), -t (threads)
-    while ((opt = getopt(argc, argv, "i:c:t:")) != -1) {
+    // Parsing delle opzioni: -i (input init), -c (input circuito), -t (threads),
+    // --serve (modalità daemon su socket Unix), --batch (manifest di job)
+    while ((opt = getopt_long(argc, argv, "i:c:t:O", long_options, NULL)) != -1) {
         switch (opt) {
             case 'i': init_file = optarg; break;
             case 'c': circ_file = optarg; break;
-            case 't': n_threads = atoi(optarg); break;
+            case 't':
+                // -t auto: configurazione scelta dall'autotuner
+                if (strcmp(optarg, "auto") == 0) auto_threads = 1;
+                else n_threads = atoi(optarg);
+                break;
+            case 'S': socket_path = optarg; break;
+            case 'B': manifest = optarg; break;
+            case 'N': n_trajectories = strtoul(optarg, NULL, 10); break;
+            case 'R': seed = strtoull(optarg, NULL, 10); break;
+            case 'U': unitary_file = optarg; break;
+            case 'W': sweep_file = optarg; break;
+            case 'K': compile = 1; break;
+            case 'O': optimize = 1; break;
+            case 'P': sparse = 1; break;
+            case 'F':
+                if (strcmp(optarg, "bin") == 0) unitary_format = UNITARY_BINARY;
+                else if (strcmp(optarg, "text") == 0) unitary_format = UNITARY_TEXT;
+                else {
+                    fprintf(stderr, "Errore: formato dell'unitaria non valido (text|bin).\n");
+                    return EXIT_FAILURE;
+                }
+                break;
             default:
-                fprintf(stderr, "Uso: %s -i init.q -c circ.q [-t threads]\n", argv[0]);
+                fprintf(stderr, USAGE, argv[0], argv[0], argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
+    // Fuori dalla simulazione singola (daemon, batch, traiettorie) "auto"
+    // usa tutti i core disponibili
+    if (auto_threads) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = ncpu > 0 ? (int)ncpu : 1;
+    }
+
+    if (n_threads < 1) {
+        fprintf(stderr, "Errore: il numero di thread deve essere positivo.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Modalità daemon: i job arrivano dal socket
+    if (socket_path)
+        return server_run(socket_path, (size_t)n_threads);
+
+    // Modalità batch: molti circuiti eseguiti in parallelo a livello di job
+    if (manifest)
+        return batch_run(manifest, (size_t)n_threads);
+
     // Verifica che i file obbligatori siano stati forniti
     if (!init_file || !circ_file) {
         fprintf(stderr, "Errore: File di inizializzazione e circuito richiesti.\n");
-        fprintf(stderr, "Uso: %s -i init.q -c circ.q [-t threads]\n", argv[0]);
+        fprintf(stderr, USAGE, argv[0], argv[0], argv[0]);
         return EXIT_FAILURE;
     }
 
     Circuit circuit;
     
     // Caricamento dei dati dai file
-    parse_init_file(init_file, &circuit);
-    parse_circ_file(circ_file, &circuit);
+    if (parse_init_file(init_file, &circuit) != 0) return EXIT_FAILURE;
+    if (parse_circ_file(circ_file, &circuit) != 0) {
+        circuit_free(&circuit);
+        return EXIT_FAILURE;
+    }
+
+    // Oltre CIRCUIT_DENSE_MAX_QUBITS qubit lo stato esiste solo in forma sparsa;
+    // l'unitaria richiede inoltre la matrice densa di ogni gate
+    int sparse_only = circuit.state.data == NULL;
+    int noisy = circuit.noise_count > 0 || n_trajectories > 0;
+    if (sparse_only && (unitary_file || sweep_file || compile || noisy)) {
+        fprintf(stderr, "Errore: con %u qubit è disponibile solo la simulazione sparsa.\n", circuit.n_qubits);
+        circuit_free(&circuit);
+        return EXIT_FAILURE;
+    }
+    // Lo sweep esegue il circuito senza rumore: meglio rifiutarlo che ignorare #noise
+    if (sweep_file && noisy) {
+        fprintf(stderr, "Errore: --sweep non supporta la simulazione rumorosa (#noise o --trajectories).\n");
+        circuit_free(&circuit);
+        return EXIT_FAILURE;
+    }
+    // Le matrici dense dei gate definiti con "on" vengono costruite solo qui
+    for (size_t g = 0; g < circuit.gate_count && unitary_file; g++) {
+        if (!circuit_gate_matrix(&circuit, g)) {
+            fprintf(stderr, "Errore: il gate %s non ha una matrice densa (%u qubit).\n",
+                    circuit.gates[g].name, circuit.n_qubits);
+            circuit_free(&circuit);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Blocchi #repeat: ripetizione diretta oppure potenza calcolata per quadrati
+    if (circuit.repeat_count > 0) {
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        int status = circuit_expand_repeats(&circuit, &pool);
+        threadpool_free(&pool);
+        if (status != 0) {
+            circuit_free(&circuit);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Ottimizzazione peephole: la fase globale dei gate rimossi viene applicata
+    // allo stato iniziale (o all'unitaria), quindi il risultato non cambia
+    Complex phase = {1.0, 0.0};
+    if (optimize) {
+        if (circuit.noise_count > 0)
+            fprintf(stderr, "Attenzione: -O ignorato, il rumore si applica dopo ogni gate.\n");
+        else
+            phase = circuit_optimize(&circuit);
+    }
+
+    // Modalità unitaria: prodotto di tutti i gate invece dell'azione sullo stato
+    if (unitary_file) {
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        ComplexMatrix u = circuit_unitary(&circuit, &pool);
+        threadpool_free(&pool);
+        if (optimize) {
+            ComplexVector elements = {u.data, u.rows * u.cols};
+            scale_complex_vector(&elements, phase);
+        }
+
+        int status = unitary_write(unitary_file, &u, unitary_format);
+        if (status != 0) fprintf(stderr, "Errore: impossibile scrivere %s\n", unitary_file);
+        free_complex_matrix(&u);
+        circuit_free(&circuit);
+        return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (optimize) {
+        if (sparse_only) scale_sparse_vector(&circuit.sparse, phase);
+        else scale_complex_vector(&circuit.state, phase);
+    }
+
+    // Sweep dei parametri: un'esecuzione per punto, con riuso del prefisso
+    if (sweep_file) {
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        int status = sweep_run(&circuit, sweep_file, &pool);
+        threadpool_free(&pool);
+        circuit_free(&circuit);
+        return status;
+    }
+
+    // Simulazione rumorosa: traiettorie Monte Carlo in parallelo
+    if (circuit.noise_count > 0 || n_trajectories > 0) {
+        if (n_trajectories == 0) n_trajectories = TRAJECTORIES_DEFAULT;
+        double *probs = malloc(circuit.dim * sizeof(double));
+        if (!probs) {
+            perror("Errore malloc probs");
+            return EXIT_FAILURE;
+        }
+
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        trajectories_run(&circuit, &pool, n_trajectories, seed, probs);
+        threadpool_free(&pool);
+
+        trajectories_print(&circuit, probs);
+        free(probs);
+        circuit_free(&circuit);
+        return EXIT_SUCCESS;
+    }
 
     // Esecuzione della simulazione parallela
-    circuit_execute_parallel(&circuit, n_threads);
+    if (sparse || sparse_only) {
+        // Solo le ampiezze non nulle, con passaggio allo stato denso se crescono
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        int status = circuit_execute_sparse(&circuit, &pool);
+        threadpool_free(&pool);
+        if (status != 0) {
+            circuit_free(&circuit);
+            return EXIT_FAILURE;
+        }
+    } else if (compile) {
+        // Kernel specializzati generati, compilati e caricati con dlopen
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        CompiledCircuit cc;
+        if (codegen_load(&circuit, &cc) == 0) {
+            codegen_execute(&circuit, &cc, &pool, NULL);
+            codegen_unload(&cc);
+        } else {
+            fprintf(stderr, "Attenzione: compilazione non riuscita, uso il kernel generico.\n");
+            circuit_execute_pool(&circuit, &pool, NULL);
+        }
+        threadpool_free(&pool);
+    } else if (auto_threads) {
+        ExecConfig cfg;
+        autotune_config(&circuit, &cfg);
+
+        ThreadPool pool;
+        threadpool_init(&pool, cfg.n_threads);
+        circuit_execute_config(&circuit, &pool, cfg.chunk, cfg.kernel, NULL);
+        threadpool_free(&pool);
+    } else {
+        ThreadPool pool;
+        threadpool_init(&pool, (size_t)n_threads);
+        circuit_execute_pool(&circuit, &pool, NULL);
+        threadpool_free(&pool);
+    }
 
     // Output del risultato finale
     circuit_print_state(&circuit);
@@ -49,4 +272,4 @@ int main(int argc, char *argv[]) {
     circuit_free(&circuit);
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
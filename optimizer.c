@@ -0,0 +1,204 @@
+#include "optimizer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* TABELLA DELLE COPPIE */
+
+// Stato di una voce della tabella delle coppie
+#define PAIR_UNKNOWN 0
+#define PAIR_CANCELS 1
+#define PAIR_KEEPS   2
+
+typedef struct {
+    Circuit *c;
+    unsigned char *pair;     /* gate_count x gate_count, indice [primo][secondo] */
+    Complex *pair_phase;
+    unsigned char *single;   /* PAIR_CANCELS se il gate è una fase globale */
+    Complex *single_phase;
+    char *fixed;             /* gate parametrici: mai rimossi */
+    size_t products;
+} Optimizer;
+
+/* Fase di modulo unitario corrispondente a z */
+static Complex unit_phase(Complex z) {
+    double m = complex_mod(z);
+    return (Complex){z.real / m, z.imag / m};
+}
+
+/**
+ * Verifica se m è lambda * I; in caso affermativo scrive in *phase la fase
+ * lambda normalizzata a modulo 1.
+ */
+static int is_phase_identity(const ComplexMatrix *m, Complex *phase) {
+    Complex lambda = MAT(m, 0, 0);
+    if (fabs(complex_mod(lambda) - 1.0) > OPTIMIZER_TOLERANCE) return 0;
+
+    const Complex zero = {0.0, 0.0};
+    for (size_t i = 0; i < m->rows; i++) {
+        for (size_t j = 0; j < m->cols; j++) {
+            Complex expected = (i == j) ? lambda : zero;
+            if (!complex_equal(MAT(m, i, j), expected, OPTIMIZER_TOLERANCE)) return 0;
+        }
+    }
+    *phase = unit_phase(lambda);
+    return 1;
+}
+
+/**
+ * Controllo rapido sulla prima riga di B * A prima del prodotto completo:
+ * deve essere lambda * e_0.
+ */
+static int first_row_is_phase(const ComplexMatrix *b, const ComplexMatrix *a) {
+    const Complex zero = {0.0, 0.0};
+    for (size_t j = 0; j < a->cols; j++) {
+        Complex sum = zero;
+        for (size_t k = 0; k < b->cols; k++)
+            sum = complex_add(sum, complex_mul(MAT(b, 0, k), MAT(a, k, j)));
+        if (j == 0) {
+            if (fabs(complex_mod(sum) - 1.0) > OPTIMIZER_TOLERANCE) return 0;
+        } else if (!complex_equal(sum, zero, OPTIMIZER_TOLERANCE)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Le matrici di 'first' e 'second' da confrontare: se entrambi i gate hanno
+ * la matrice locale, le matrici estese all'unione dei supporti (al più
+ * 2 * GATE_LOCAL_MAX_QUBITS qubit), altrimenti le matrici dense.
+ * Output: 0 se le matrici non sono disponibili (registro troppo grande)
+ */
+static int pair_matrices(Circuit *c, size_t first, size_t second,
+                         ComplexMatrix *a, ComplexMatrix *b, int *owned) {
+    const Gate *ga = &c->gates[first], *gb = &c->gates[second];
+    if (ga->local.data && gb->local.data) {
+        unsigned int u[2 * GATE_LOCAL_MAX_QUBITS];
+        unsigned int ulen = gate_support_union(gb, u, gate_support_union(ga, u, 0));
+        *a = gate_local_on(ga, u, ulen);
+        *b = gate_local_on(gb, u, ulen);
+        *owned = 1;
+        return 1;
+    }
+
+    const ComplexMatrix *da = circuit_gate_matrix(c, first);
+    const ComplexMatrix *db = circuit_gate_matrix(c, second);
+    if (!da || !db) return 0;
+    *a = *da;
+    *b = *db;
+    *owned = 0;
+    return 1;
+}
+
+/**
+ * Il gate 'second' applicato dopo 'first' si riduce a una fase globale?
+ * Il risultato viene calcolato una sola volta per coppia.
+ */
+static int pair_cancels(Optimizer *o, size_t first, size_t second, Complex *phase) {
+    size_t idx = first * o->c->gate_count + second;
+    if (o->pair[idx] == PAIR_UNKNOWN) {
+        ComplexMatrix a, b;
+        int owned;
+        o->pair[idx] = PAIR_KEEPS;
+        if (!o->fixed[first] && !o->fixed[second] &&
+            pair_matrices(o->c, first, second, &a, &b, &owned)) {
+            if (first_row_is_phase(&b, &a)) {
+                ComplexMatrix p = matrix_mul(&b, &a);
+                o->products++;
+                if (is_phase_identity(&p, &o->pair_phase[idx])) o->pair[idx] = PAIR_CANCELS;
+                free_complex_matrix(&p);
+            }
+            if (owned) {
+                free_complex_matrix(&a);
+                free_complex_matrix(&b);
+            }
+        }
+    }
+    *phase = o->pair_phase[idx];
+    return o->pair[idx] == PAIR_CANCELS;
+}
+
+/* Il gate è l'identità a meno di una fase globale? */
+static int single_cancels(Optimizer *o, size_t gate, Complex *phase) {
+    if (o->single[gate] == PAIR_UNKNOWN) {
+        // La matrice locale è l'identità se e solo se lo è quella densa
+        const Gate *g = &o->c->gates[gate];
+        const ComplexMatrix *m = g->local.data ? &g->local : &g->matrix;
+        o->single[gate] = PAIR_KEEPS;
+        if (!o->fixed[gate] && m->data && is_phase_identity(m, &o->single_phase[gate]))
+            o->single[gate] = PAIR_CANCELS;
+    }
+    *phase = o->single_phase[gate];
+    return o->single[gate] == PAIR_CANCELS;
+}
+
+
+/* PASSAGGIO DI OTTIMIZZAZIONE */
+
+/**
+ * Un passaggio sulla sequenza: la sequenza ottimizzata viene costruita come
+ * uno stack (in place), confrontando ogni gate con la cima.
+ * Output: numero di gate rimossi; *phase viene aggiornata
+ */
+static size_t optimize_pass(Optimizer *o, Complex *phase) {
+    Circuit *c = o->c;
+    size_t top = 0;
+    Complex p;
+
+    for (size_t s = 0; s < c->sequence_len; s++) {
+        size_t g = c->sequence[s];
+        if (single_cancels(o, g, &p)) {
+            *phase = complex_mul(*phase, p);
+        } else if (top > 0 && pair_cancels(o, c->sequence[top - 1], g, &p)) {
+            *phase = complex_mul(*phase, p);
+            top--;
+        } else {
+            c->sequence[top++] = g;
+        }
+    }
+
+    size_t removed = c->sequence_len - top;
+    c->sequence_len = top;
+    return removed;
+}
+
+Complex circuit_optimize(Circuit *c) {
+    Complex phase = {1.0, 0.0};
+    size_t before = c->sequence_len;
+    if (c->gate_count == 0) return phase;
+
+    Optimizer o;
+    size_t n = c->gate_count;
+    o.c = c;
+    o.pair = calloc(n * n, 1);
+    o.pair_phase = calloc(n * n, sizeof(Complex));
+    o.single = calloc(n, 1);
+    o.single_phase = calloc(n, sizeof(Complex));
+    o.fixed = calloc(n, 1);
+    o.products = 0;
+    if (!o.pair || !o.pair_phase || !o.single || !o.single_phase || !o.fixed) {
+        perror("Errore calloc optimizer");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t k = 0; k < c->param_gate_count; k++)
+        o.fixed[c->param_gates[k].gate] = 1;
+
+    // Ripete i passaggi finché la sequenza non cambia più
+    size_t passes = 0;
+    do {
+        passes++;
+    } while (optimize_pass(&o, &phase) > 0);
+
+    fprintf(stderr, "Ottimizzazione: %zu gate -> %zu gate (%zu passaggi, %zu prodotti matriciali)\n",
+            before, c->sequence_len, passes, o.products);
+
+    free(o.pair);
+    free(o.pair_phase);
+    free(o.single);
+    free(o.single_phase);
+    free(o.fixed);
+    return phase;
+}
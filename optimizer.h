@@ -0,0 +1,30 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "circuit.h"
+
+// Tolleranza sugli elementi: i file di circuito riportano coefficienti a 5 decimali
+#define OPTIMIZER_TOLERANCE 1e-4
+
+/**
+ * Ottimizzazione peephole della sequenza #circ.
+ *
+ * Rimuove i gate la cui matrice è l'identità (eventualmente per una fase
+ * globale) e le coppie di gate adiacenti il cui prodotto è l'identità a meno
+ * di una fase (H H, X X, un gate seguito dal suo aggiunto...). Il risultato
+ * per ogni coppia di gate viene calcolato con matrix_mul al primo incontro e
+ * memorizzato. La sequenza viene scorsa con uno stack, così le cancellazioni
+ * annidate (A B B' A') vengono trovate nello stesso passaggio; i passaggi si
+ * ripetono fino a un punto fisso. I gate parametrici non vengono toccati,
+ * perché la loro matrice può cambiare. I gate definiti sui soli qubit su cui
+ * agiscono vengono confrontati con le matrici locali (estese all'unione dei
+ * due supporti), senza costruire la matrice densa.
+ *
+ * Input: c (circuito)
+ * Output: fase globale dei gate rimossi, da moltiplicare allo stato (o
+ * all'unitaria) per ottenere lo stesso risultato del circuito originale.
+ * Stampa su standard error il numero di gate prima e dopo.
+ */
+Complex circuit_optimize(Circuit *c);
+
+#endif
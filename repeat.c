@@ -0,0 +1,259 @@
+#include "repeat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* SEQUENZA IN COSTRUZIONE */
+
+typedef struct {
+    size_t *data;
+    size_t len;
+    size_t cap;
+} Sequence;
+
+static void seq_push(Sequence *s, size_t gate) {
+    if (s->len == s->cap) {
+        s->cap = s->cap ? 2 * s->cap : 16;
+        s->data = realloc(s->data, s->cap * sizeof(size_t));
+        if (!s->data) {
+            perror("Errore realloc sequence");
+            exit(EXIT_FAILURE);
+        }
+    }
+    s->data[s->len++] = gate;
+}
+
+typedef struct {
+    Circuit *c;
+    ThreadPool *pool;
+    const size_t *source;   /* sequenza con una sola copia di ogni blocco */
+    size_t next;            /* prossimo blocco da considerare (ordinati) */
+    char *parametric;       /* gate con matrice dipendente da un parametro */
+    size_t parametric_len;  /* i gate sintetizzati dopo non sono parametrici */
+} Expander;
+
+
+/* MODELLO DI COSTO */
+
+/* Costo stimato di un'applicazione del gate, in operazioni sullo stato */
+static double gate_cost(Circuit *c, size_t gi) {
+    double dim = (double)c->dim;
+    Gate *g = &c->gates[gi];
+    if (g->transform != TRANSFORM_NONE) return dim * c->n_qubits;
+    circuit_analyze_gate(c, gi);
+    if (g->local.data) return dim * (double)((size_t)1 << g->support_len);
+    return dim * dim;
+}
+
+/* Prodotti da N^3 necessari per U^count: quadrati più moltiplicazioni dei bit a 1 */
+static size_t power_products(size_t count) {
+    size_t squarings = 0, ones = 0;
+    for (size_t k = count; k > 1; k >>= 1) squarings++;
+    for (size_t k = count; k; k >>= 1) ones += k & 1;
+    return squarings + ones - 1;
+}
+
+static ComplexMatrix multiply(const ComplexMatrix *a, const ComplexMatrix *b, ThreadPool *pool) {
+    return pool ? matrix_mul_parallel(a, b, pool) : matrix_mul(a, b);
+}
+
+
+/* ESPANSIONE */
+
+/* base^count per quadrati successivi (le potenze commutano); base viene liberata */
+static ComplexMatrix matrix_power(ComplexMatrix base, size_t count, ThreadPool *pool) {
+    ComplexMatrix result = {0, 0, NULL};
+    for (size_t k = count; k > 0; k >>= 1) {
+        if (k & 1) {
+            if (!result.data) {
+                result = copy_complex_matrix(&base);
+            } else {
+                ComplexMatrix next = multiply(&base, &result, pool);
+                free_complex_matrix(&result);
+                result = next;
+            }
+        }
+        if (k > 1) {
+            ComplexMatrix sq = multiply(&base, &base, pool);
+            free_complex_matrix(&base);
+            base = sq;
+        }
+    }
+    free_complex_matrix(&base);
+    return result;
+}
+
+/**
+ * U^count del corpo, registrata come nuovo gate.
+ * Output: indice del gate
+ */
+static size_t build_power(Expander *e, const Sequence *body, size_t count) {
+    Circuit *c = e->c;
+
+    // U = G_{len-1} ... G_0: i gate successivi moltiplicano a sinistra.
+    // Con al più REPEAT_MAX_POWER_QUBITS qubit ogni gate ha la matrice densa
+    ComplexMatrix base = copy_complex_matrix(circuit_gate_matrix(c, body->data[0]));
+    for (size_t i = 1; i < body->len; i++) {
+        ComplexMatrix next = multiply(circuit_gate_matrix(c, body->data[i]), &base, e->pool);
+        free_complex_matrix(&base);
+        base = next;
+    }
+    ComplexMatrix result = matrix_power(base, count, e->pool);
+
+    char name[64];
+    snprintf(name, sizeof(name), "repeat%zu^%zu", c->gate_count, count);
+    circuit_add_gate(c, name, result);
+    return c->gate_count - 1;
+}
+
+/**
+ * U^count del corpo sui qubit ordinati u[0..ulen), che contengono i supporti
+ * di tutti i gate (locali) del corpo, registrata come nuovo gate locale.
+ * Output: indice del gate
+ */
+static size_t build_local_power(Expander *e, const Sequence *body, size_t count,
+                                const unsigned int *u, unsigned int ulen) {
+    Circuit *c = e->c;
+
+    // Matrici da 2^ulen x 2^ulen: prodotti nel thread chiamante
+    ComplexMatrix base = gate_local_on(&c->gates[body->data[0]], u, ulen);
+    for (size_t i = 1; i < body->len; i++) {
+        ComplexMatrix g = gate_local_on(&c->gates[body->data[i]], u, ulen);
+        ComplexMatrix next = matrix_mul(&g, &base);
+        free_complex_matrix(&g);
+        free_complex_matrix(&base);
+        base = next;
+    }
+    ComplexMatrix result = matrix_power(base, count, NULL);
+
+    char name[64];
+    snprintf(name, sizeof(name), "repeat%zu^%zu", c->gate_count, count);
+    circuit_add_local_gate(c, name, u, ulen, result);
+    return c->gate_count - 1;
+}
+
+/**
+ * Emette il blocco ripetuto in out, scegliendo tra ripetizione e potenza.
+ * Output: 0, -1 se la ripetizione supera REPEAT_MAX_SEQUENCE gate
+ */
+static int emit_repeat(Expander *e, const Sequence *body, size_t count, Sequence *out) {
+    Circuit *c = e->c;
+    if (count == 0 || body->len == 0) return 0;
+
+    int can_power = count > 1 && c->noise_count == 0;
+    double sweep_cost = 0.0;
+    for (size_t i = 0; i < body->len; i++) {
+        size_t gi = body->data[i];
+        if (gi < e->parametric_len && e->parametric[gi]) can_power = 0;
+        sweep_cost += gate_cost(c, body->data[i]);
+    }
+
+    // Unione dei supporti: se tutti i gate sono locali e l'unione ha al più
+    // GATE_LOCAL_MAX_QUBITS qubit la potenza costa solo prodotti da 2^k x 2^k
+    unsigned int u[2 * GATE_LOCAL_MAX_QUBITS];
+    unsigned int ulen = 0;
+    int local = can_power;
+    for (size_t i = 0; i < body->len && local; i++) {
+        const Gate *g = &c->gates[body->data[i]];
+        if (g->transform != TRANSFORM_NONE || !g->local.data) local = 0;
+        else ulen = gate_support_union(g, u, ulen);
+        if (ulen > GATE_LOCAL_MAX_QUBITS) local = 0;
+    }
+    if (local) {
+        // Corpo che agisce solo con una fase: un qubit qualsiasi come supporto
+        if (ulen == 0) u[ulen++] = 0;
+        size_t products = body->len - 1 + power_products(count);
+        seq_push(out, build_local_power(e, body, count, u, ulen));
+        fprintf(stderr, "Repeat: %zu x %zu gate -> gate %s su %u qubit (%zu prodotti matriciali)\n",
+                count, body->len, c->gates[c->gate_count - 1].name, ulen, products);
+        return 0;
+    }
+    if (c->n_qubits > REPEAT_MAX_POWER_QUBITS) can_power = 0;
+
+    if (can_power) {
+        double dim = (double)c->dim;
+        size_t products = body->len - 1 + power_products(count);
+        double power_cost = (double)products * dim * dim * dim + dim * dim;
+        if (power_cost < (double)count * sweep_cost) {
+            seq_push(out, build_power(e, body, count));
+            fprintf(stderr, "Repeat: %zu x %zu gate -> gate %s (%zu prodotti matriciali)\n",
+                    count, body->len, c->gates[c->gate_count - 1].name, products);
+            return 0;
+        }
+    }
+
+    // Controllo prima di espandere: count * len può anche superare SIZE_MAX
+    if (out->len > REPEAT_MAX_SEQUENCE || count > (REPEAT_MAX_SEQUENCE - out->len) / body->len) {
+        fprintf(stderr, "Circ parser error: #repeat %zu of %zu gates expands to more than %d gates\n",
+                count, body->len, REPEAT_MAX_SEQUENCE);
+        return -1;
+    }
+    for (size_t k = 0; k < count; k++)
+        for (size_t i = 0; i < body->len; i++) seq_push(out, body->data[i]);
+    return 0;
+}
+
+/* Espande le posizioni [lo, hi) della sequenza sorgente, con i blocchi contenuti */
+static int expand_range(Expander *e, size_t lo, size_t hi, Sequence *out) {
+    const Circuit *c = e->c;
+    size_t i = lo;
+
+    while (i < hi) {
+        const RepeatBlock *r = e->next < c->repeat_count ? &c->repeats[e->next] : NULL;
+        if (r && r->start == i && r->start + r->len <= hi) {
+            e->next++;
+            Sequence body = {NULL, 0, 0};
+            int status = expand_range(e, i, i + r->len, &body);
+            if (status == 0) status = emit_repeat(e, &body, r->count, out);
+            free(body.data);
+            if (status != 0) return -1;
+            i += r->len;
+        } else {
+            seq_push(out, e->source[i++]);
+        }
+    }
+    return 0;
+}
+
+/* Blocchi in ordine di inizio; a parità, prima il più esterno (più lungo) */
+static int compare_blocks(const void *a, const void *b) {
+    const RepeatBlock *x = (const RepeatBlock *)a, *y = (const RepeatBlock *)b;
+    if (x->start != y->start) return (x->start > y->start) - (x->start < y->start);
+    return (x->len < y->len) - (x->len > y->len);
+}
+
+int circuit_expand_repeats(Circuit *c, ThreadPool *pool) {
+    if (c->repeat_count == 0) return 0;
+    qsort(c->repeats, c->repeat_count, sizeof(RepeatBlock), compare_blocks);
+
+    Expander e;
+    e.c = c;
+    e.pool = pool;
+    e.source = c->sequence;
+    e.next = 0;
+    e.parametric_len = c->gate_count;
+    e.parametric = calloc(c->gate_count + 1, 1);
+    if (!e.parametric) {
+        perror("Errore calloc parametric");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t k = 0; k < c->param_gate_count; k++)
+        e.parametric[c->param_gates[k].gate] = 1;
+
+    Sequence out = {NULL, 0, 0};
+    int status = expand_range(&e, 0, c->sequence_len, &out);
+    free(e.parametric);
+    if (status != 0) {
+        free(out.data);
+        return -1;
+    }
+
+    free(c->sequence);
+    free(c->repeats);
+    c->sequence = out.data;
+    c->sequence_len = out.len;
+    c->repeats = NULL;
+    c->repeat_count = 0;
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include "circuit.h"
+
+// Oltre questo numero di qubit le potenze dense non vengono calcolate (matrici da 2^n x 2^n)
+#define REPEAT_MAX_POWER_QUBITS 12
+
+// Lunghezza massima della sequenza dopo l'espansione dei blocchi ripetuti
+#define REPEAT_MAX_SEQUENCE (1 << 24)
+
+/**
+ * Risolve i blocchi #repeat del circuito in una sequenza piatta.
+ *
+ * Per ogni blocco (dall'interno verso l'esterno, se annidati) confronta:
+ * - applicazione diretta: count volte il costo dei gate del corpo, stimato
+ *   in operazioni sullo stato (N^2 per un gate denso, N 2^k per un gate
+ *   locale su k qubit, N log N per una trasformata veloce);
+ * - potenza: prodotto U dei gate del corpo e U^count per quadrati successivi
+ *   con matrix_mul_parallel, cioè (len - 1 + log2 count + bit(count) - 1)
+ *   prodotti da N^3, più una sola applicazione di U^count.
+ * Se conviene la potenza, U^count viene registrata come nuovo gate e
+ * inserita nella sequenza al posto del blocco. Se i gate del corpo sono tutti
+ * locali e l'unione dei loro supporti ha al più GATE_LOCAL_MAX_QUBITS qubit,
+ * U e U^count vengono calcolate sulla sola unione (prodotti da 2^k x 2^k,
+ * con qualunque numero di qubit del registro) e U^count diventa un gate
+ * locale: la potenza è sempre scelta. Le potenze dense servono solo per i
+ * corpi sull'intero registro. Con gate parametrici nel corpo
+ * o con canali di rumore il blocco viene sempre ripetuto: se la sequenza
+ * espansa supererebbe REPEAT_MAX_SEQUENCE gate l'espansione fallisce con un
+ * errore invece di allocare count * len posizioni.
+ *
+ * Input: c (circuito), pool (NULL per i prodotti nel thread chiamante)
+ * Output: 0, -1 se la sequenza espansa è troppo lunga (sequenza invariata)
+ */
+int circuit_expand_repeats(Circuit *c, ThreadPool *pool);
+
+#endif
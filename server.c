@@ -0,0 +1,557 @@
+#define _POSIX_C_SOURCE 200809L
+#include "server.h"
+#include "circuit.h"
+#include "initparser.h"
+#include "circparser.h"
+#include "repeat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define MAX_LINE 4096
+#define MAX_QUBITS 63
+#define LATENCY_WINDOW 4096   /* numero di latenze recenti usate per i percentili */
+#define MAX_CACHED_SETS 64    /* circuiti in cache per percorso (RUN), oltre si scarta il meno recente */
+#define MAX_CLIENTS 64        /* connessioni servite contemporaneamente */
+#define CLIENT_TIMEOUT_S 300  /* una connessione inattiva per più secondi viene chiusa */
+
+
+/* STRUTTURE DEL SERVER */
+
+/**
+ * Insieme di gate residente: circuito già parsato (gate + sequenza)
+ * riutilizzato da tutti i job che lo referenziano.
+ * - key      : nome assegnato con LOAD, oppure percorso del file per RUN
+ * - named    : caricato con LOAD (mai scartato dalla cache)
+ * - mtime, size, ino, dev: identità del file al momento del parsing
+ * - last_use : contatore dell'ultimo uso, per scartare il meno recente
+ */
+typedef struct {
+    char *key;
+    int named;
+    struct timespec mtime;
+    off_t size;
+    ino_t ino;
+    dev_t dev;
+    unsigned long last_use;
+    Circuit tmpl;
+} GateSet;
+
+/**
+ * Stato del server, condiviso dai thread delle connessioni. Il lock protegge
+ * tutti i campi seguenti e serializza l'esecuzione dei job: il pool di
+ * thread esegue un job alla volta usando tutti i worker.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t idle_cv;                  /* segnala la chiusura di una connessione */
+    int listen_fd;
+    int clients[MAX_CLIENTS];                /* socket delle connessioni aperte */
+    size_t client_count;
+
+    ThreadPool pool;
+
+    GateSet *sets;
+    size_t set_count;
+    unsigned long use_clock;                 /* contatore per last_use */
+
+    ComplexVector scratch[MAX_QUBITS + 1];   /* buffer ausiliari per numero di qubit */
+
+    double latencies[LATENCY_WINDOW];        /* buffer circolare in microsecondi */
+    size_t lat_count;
+    size_t lat_next;
+
+    unsigned long jobs_ok;
+    unsigned long jobs_err;
+} Server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+
+/* GESTIONE DEGLI INSIEMI DI GATE */
+
+static GateSet *find_set(Server *srv, const char *key) {
+    for (size_t i = 0; i < srv->set_count; i++) {
+        if (strcmp(srv->sets[i].key, key) == 0) {
+            srv->sets[i].last_use = ++srv->use_clock;
+            return &srv->sets[i];
+        }
+    }
+    return NULL;
+}
+
+/* Il file è ancora quello parsato? (mtime al nanosecondo, dimensione, inode) */
+static int same_file(const GateSet *set, const struct stat *st) {
+    return set->mtime.tv_sec == st->st_mtim.tv_sec && set->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           set->size == st->st_size && set->ino == st->st_ino && set->dev == st->st_dev;
+}
+
+/* Scarta il circuito in cache per percorso usato meno di recente */
+static void evict_set(Server *srv) {
+    size_t victim = srv->set_count, cached = 0;
+    for (size_t i = 0; i < srv->set_count; i++) {
+        if (srv->sets[i].named) continue;
+        cached++;
+        if (victim == srv->set_count || srv->sets[i].last_use < srv->sets[victim].last_use)
+            victim = i;
+    }
+    if (cached < MAX_CACHED_SETS) return;
+
+    free(srv->sets[victim].key);
+    circuit_free(&srv->sets[victim].tmpl);
+    srv->sets[victim] = srv->sets[--srv->set_count];
+}
+
+/**
+ * Parsa il file del circuito per n_qubits qubit e lo registra sotto 'key',
+ * sostituendo un eventuale insieme con la stessa chiave. Il template non ha
+ * un proprio vettore di stato: i job usano il loro.
+ * Output: l'insieme caricato, NULL se il file non è valido (l'insieme
+ * precedente con la stessa chiave resta invariato)
+ */
+static GateSet *load_set(Server *srv, const char *key, int named, const char *path,
+                         unsigned int n_qubits, const struct stat *st) {
+    Circuit tmpl;
+    circuit_init_template(&tmpl, n_qubits);
+    if (parse_circ_file(path, &tmpl) != 0 || circuit_expand_repeats(&tmpl, &srv->pool) != 0) {
+        circuit_free(&tmpl);
+        return NULL;
+    }
+
+    GateSet *set = find_set(srv, key);
+    if (set) {
+        circuit_free(&set->tmpl);
+    } else {
+        if (!named) evict_set(srv);
+        srv->sets = realloc(srv->sets, (srv->set_count + 1) * sizeof(GateSet));
+        if (!srv->sets) {
+            perror("Errore realloc gate set");
+            exit(EXIT_FAILURE);
+        }
+        set = &srv->sets[srv->set_count++];
+        set->key = strdup(key);
+    }
+
+    set->named = named;
+    set->tmpl = tmpl;
+    set->mtime = st->st_mtim;
+    set->size = st->st_size;
+    set->ino = st->st_ino;
+    set->dev = st->st_dev;
+    set->last_use = ++srv->use_clock;
+    return set;
+}
+
+static ComplexVector *get_scratch(Server *srv, unsigned int n_qubits) {
+    ComplexVector *v = &srv->scratch[n_qubits];
+    if (!v->data) *v = alloc_complex_vector((size_t)1 << n_qubits);
+    return v;
+}
+
+
+/* STATISTICHE DI LATENZA */
+
+static double elapsed_us(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+static void record_latency(Server *srv, double us) {
+    srv->latencies[srv->lat_next] = us;
+    srv->lat_next = (srv->lat_next + 1) % LATENCY_WINDOW;
+    if (srv->lat_count < LATENCY_WINDOW) srv->lat_count++;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Calcola i percentili p50 e p99 (nearest-rank) sulle latenze recenti.
+ */
+static void latency_percentiles(const Server *srv, double *p50, double *p99) {
+    *p50 = *p99 = 0.0;
+    if (srv->lat_count == 0) return;
+
+    double sorted[LATENCY_WINDOW];
+    memcpy(sorted, srv->latencies, srv->lat_count * sizeof(double));
+    qsort(sorted, srv->lat_count, sizeof(double), compare_double);
+
+    size_t n = srv->lat_count;
+    *p50 = sorted[(n * 50 + 99) / 100 - 1];
+    *p99 = sorted[(n * 99 + 99) / 100 - 1];
+}
+
+
+/* COMANDI */
+
+static void count_job(Server *srv, int ok) {
+    pthread_mutex_lock(&srv->lock);
+    if (ok) srv->jobs_ok++;
+    else srv->jobs_err++;
+    pthread_mutex_unlock(&srv->lock);
+}
+
+/**
+ * Trova (o parsa e mette in cache) l'insieme di gate di un job; da chiamare
+ * con il lock del server.
+ * Output: l'insieme, NULL dopo aver scritto l'errore su out
+ */
+static GateSet *resolve_set(Server *srv, const char *circ_ref, unsigned int n_qubits, FILE *out) {
+    GateSet *set;
+    if (circ_ref[0] == '@') {
+        set = find_set(srv, circ_ref + 1);
+        if (!set) {
+            fprintf(out, "ERR unknown gate set %s\n", circ_ref + 1);
+            return NULL;
+        }
+    } else {
+        struct stat st;
+        if (stat(circ_ref, &st) != 0 || access(circ_ref, R_OK) != 0) {
+            fprintf(out, "ERR cannot read circuit file %s\n", circ_ref);
+            return NULL;
+        }
+        // Riparsa solo se il file è cambiato o se serve un numero di qubit diverso
+        set = find_set(srv, circ_ref);
+        if (!set || !same_file(set, &st) || set->tmpl.n_qubits != n_qubits)
+            set = load_set(srv, circ_ref, 0, circ_ref, n_qubits, &st);
+        if (!set) {
+            fprintf(out, "ERR invalid circuit file %s\n", circ_ref);
+            return NULL;
+        }
+    }
+
+    if (set->tmpl.n_qubits != n_qubits) {
+        fprintf(out, "ERR gate set has %u qubits, init has %u\n", set->tmpl.n_qubits, n_qubits);
+        return NULL;
+    }
+    return set;
+}
+
+/**
+ * Esegue un job: carica lo stato iniziale e applica i gate dell'insieme
+ * residente, senza copiarli. La risposta contiene lo stato finale.
+ * Lo stato iniziale viene letto e la risposta scritta fuori dal lock.
+ */
+static void cmd_run(Server *srv, const char *init_file, const char *circ_ref, FILE *out) {
+    if (access(init_file, R_OK) != 0) {
+        fprintf(out, "ERR cannot read init file %s\n", init_file);
+        count_job(srv, 0);
+        return;
+    }
+
+    Circuit job;
+    if (parse_init_file(init_file, &job) != 0) {
+        fprintf(out, "ERR invalid init file %s\n", init_file);
+        count_job(srv, 0);
+        return;
+    }
+    if (job.n_qubits > MAX_QUBITS || !job.state.data) {
+        fprintf(out, "ERR too many qubits\n");
+        circuit_free(&job);
+        count_job(srv, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&srv->lock);
+    GateSet *set = resolve_set(srv, circ_ref, job.n_qubits, out);
+    if (set) {
+        // Il job usa i gate e la sequenza del template senza duplicarli
+        job.gates = set->tmpl.gates;
+        job.gate_count = set->tmpl.gate_count;
+        job.sequence = set->tmpl.sequence;
+        job.sequence_len = set->tmpl.sequence_len;
+
+        circuit_execute_pool(&job, &srv->pool, get_scratch(srv, job.n_qubits));
+
+        job.gates = NULL;
+        job.gate_count = 0;
+        job.sequence = NULL;
+        job.sequence_len = 0;
+        srv->jobs_ok++;
+    } else {
+        srv->jobs_err++;
+    }
+    pthread_mutex_unlock(&srv->lock);
+
+    if (set) {
+        fprintf(out, "OK ");
+        circuit_fprint_state(out, &job);
+    }
+    circuit_free(&job);
+}
+
+static void cmd_load(Server *srv, const char *name, const char *qubits, const char *path, FILE *out) {
+    char *end;
+    unsigned long n = strtoul(qubits, &end, 10);
+    if (*end != '\0' || n > MAX_QUBITS) {
+        fprintf(out, "ERR invalid qubit count %s\n", qubits);
+        return;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0 || access(path, R_OK) != 0) {
+        fprintf(out, "ERR cannot read circuit file %s\n", path);
+        return;
+    }
+
+    pthread_mutex_lock(&srv->lock);
+    GateSet *set = load_set(srv, name, 1, path, (unsigned int)n, &st);
+    if (!set)
+        fprintf(out, "ERR invalid circuit file %s\n", path);
+    else
+        fprintf(out, "OK loaded %s gates=%zu sequence=%zu\n",
+                set->key, set->tmpl.gate_count, set->tmpl.sequence_len);
+    pthread_mutex_unlock(&srv->lock);
+}
+
+static void cmd_stats(Server *srv, FILE *out) {
+    double p50, p99;
+    pthread_mutex_lock(&srv->lock);
+    latency_percentiles(srv, &p50, &p99);
+    fprintf(out, "OK jobs=%lu errors=%lu sets=%zu p50_us=%.1f p99_us=%.1f\n",
+            srv->jobs_ok, srv->jobs_err, srv->set_count, p50, p99);
+    pthread_mutex_unlock(&srv->lock);
+}
+
+/**
+ * Interpreta una riga di comando.
+ * Output: 0 per continuare, 1 per chiudere la connessione, 2 per terminare il server
+ */
+static int handle_line(Server *srv, char *line, FILE *out) {
+    char *save = NULL;
+    char *argv[4];
+    int argc = 0;
+    char *tok = strtok_r(line, " \t\r\n", &save);
+    while (tok && argc < 4) {
+        argv[argc++] = tok;
+        tok = strtok_r(NULL, " \t\r\n", &save);
+    }
+    if (argc == 0) return 0;
+
+    if (strcmp(argv[0], "RUN") == 0 && argc == 3) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        cmd_run(srv, argv[1], argv[2], out);
+        fflush(out);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        pthread_mutex_lock(&srv->lock);
+        record_latency(srv, elapsed_us(&t0, &t1));
+        pthread_mutex_unlock(&srv->lock);
+    } else if (strcmp(argv[0], "LOAD") == 0 && argc == 4) {
+        cmd_load(srv, argv[1], argv[2], argv[3], out);
+    } else if (strcmp(argv[0], "STATS") == 0 && argc == 1) {
+        cmd_stats(srv, out);
+    } else if (strcmp(argv[0], "QUIT") == 0) {
+        return 1;
+    } else if (strcmp(argv[0], "SHUTDOWN") == 0) {
+        fprintf(out, "OK shutdown\n");
+        return 2;
+    } else {
+        fprintf(out, "ERR unknown command\n");
+    }
+    fflush(out);
+    return 0;
+}
+
+/* Chiede la terminazione: sveglia accept() e chiude la lettura delle connessioni aperte */
+static void request_stop(Server *srv) {
+    pthread_mutex_lock(&srv->lock);
+    stop_requested = 1;
+    shutdown(srv->listen_fd, SHUT_RDWR);
+    for (size_t i = 0; i < srv->client_count; i++) shutdown(srv->clients[i], SHUT_RD);
+    pthread_mutex_unlock(&srv->lock);
+}
+
+typedef struct {
+    Server *srv;
+    int fd;
+} ClientArg;
+
+/**
+ * Thread di una connessione: legge comandi finché il client non chiude,
+ * resta inattivo oltre CLIENT_TIMEOUT_S secondi o il server termina.
+ */
+static void *serve_client(void *p) {
+    ClientArg *arg = (ClientArg *)p;
+    Server *srv = arg->srv;
+    int fd = arg->fd;
+    free(arg);
+
+    int status = 0;
+    int fd_out = dup(fd);
+    FILE *in = fdopen(fd, "r");
+    FILE *out = (fd_out >= 0) ? fdopen(fd_out, "w") : NULL;
+    if (in && out) {
+        char line[MAX_LINE];
+        while (status == 0 && !stop_requested && fgets(line, sizeof(line), in))
+            status = handle_line(srv, line, out);
+    }
+    if (status == 2) request_stop(srv);
+
+    // Prima di chiudere il socket lo si toglie dalla lista (il numero può essere riusato)
+    pthread_mutex_lock(&srv->lock);
+    for (size_t i = 0; i < srv->client_count; i++) {
+        if (srv->clients[i] == fd) {
+            srv->clients[i] = srv->clients[--srv->client_count];
+            break;
+        }
+    }
+    if (in) fclose(in); else close(fd);
+    if (out) fclose(out); else if (fd_out >= 0) close(fd_out);
+    pthread_cond_signal(&srv->idle_cv);
+    pthread_mutex_unlock(&srv->lock);
+    return NULL;
+}
+
+/**
+ * Affida la connessione a un nuovo thread, se non si è al limite di MAX_CLIENTS.
+ * I segnali restano al thread principale, che li riceve in accept().
+ */
+static void start_client(Server *srv, int fd) {
+    struct timeval tv = {CLIENT_TIMEOUT_S, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    pthread_mutex_lock(&srv->lock);
+    if (srv->client_count == MAX_CLIENTS) {
+        pthread_mutex_unlock(&srv->lock);
+        const char *msg = "ERR too many clients\n";
+        if (write(fd, msg, strlen(msg)) < 0) { /* il client ha già chiuso */ }
+        close(fd);
+        return;
+    }
+    srv->clients[srv->client_count++] = fd;
+    pthread_mutex_unlock(&srv->lock);
+
+    ClientArg *arg = malloc(sizeof(ClientArg));
+    if (!arg) {
+        perror("Errore malloc client");
+        exit(EXIT_FAILURE);
+    }
+    arg->srv = srv;
+    arg->fd = fd;
+
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    pthread_t tid;
+    int rc = pthread_create(&tid, NULL, serve_client, arg);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "Errore pthread_create: %s\n", strerror(rc));
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(tid);
+}
+
+
+/* CICLO PRINCIPALE */
+
+int server_run(const char *socket_path, size_t n_threads) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Server error: socket path too long\n");
+        return EXIT_FAILURE;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("Errore socket");
+        return EXIT_FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 16) != 0) {
+        perror("Errore bind/listen");
+        close(listen_fd);
+        return EXIT_FAILURE;
+    }
+
+    // Senza SA_RESTART: accept() viene interrotta da SIGINT/SIGTERM
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Server *srv = calloc(1, sizeof(Server));
+    if (!srv) {
+        perror("Errore calloc server");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&srv->lock, NULL);
+    pthread_cond_init(&srv->idle_cv, NULL);
+    srv->listen_fd = listen_fd;
+
+    // Anche i worker del pool lasciano i segnali al thread principale
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    threadpool_init(&srv->pool, n_threads);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    fprintf(stderr, "Server in ascolto su %s (%zu thread)\n", socket_path, srv->pool.n_threads);
+
+    while (!stop_requested) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || stop_requested) continue;
+            perror("Errore accept");
+            break;
+        }
+        start_client(srv, fd);
+    }
+
+    // Attende la chiusura delle connessioni ancora aperte
+    request_stop(srv);
+    pthread_mutex_lock(&srv->lock);
+    while (srv->client_count > 0) pthread_cond_wait(&srv->idle_cv, &srv->lock);
+    pthread_mutex_unlock(&srv->lock);
+
+    double p50, p99;
+    latency_percentiles(srv, &p50, &p99);
+    fprintf(stderr, "Server terminato: %lu job, %lu errori, p50 %.1f us, p99 %.1f us\n",
+            srv->jobs_ok, srv->jobs_err, p50, p99);
+
+    close(listen_fd);
+    unlink(socket_path);
+
+    for (size_t i = 0; i < srv->set_count; i++) {
+        free(srv->sets[i].key);
+        circuit_free(&srv->sets[i].tmpl);
+    }
+    free(srv->sets);
+    for (size_t n = 0; n <= MAX_QUBITS; n++)
+        free_complex_vector(&srv->scratch[n]);
+    threadpool_free(&srv->pool);
+    pthread_cond_destroy(&srv->idle_cv);
+    pthread_mutex_destroy(&srv->lock);
+    free(srv);
+
+    return EXIT_SUCCESS;
+}
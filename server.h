@@ -0,0 +1,32 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+
+/**
+ * Modalità daemon (--serve): resta in ascolto su un socket Unix e accetta
+ * job di simulazione, mantenendo residenti i gate già parsati, i buffer di
+ * stato e il pool di thread.
+ *
+ * Ogni connessione è servita da un proprio thread (al più 64, chiusa dopo
+ * 300 secondi di inattività); i job vengono eseguiti uno alla volta sul
+ * pool condiviso.
+ *
+ * Protocollo testuale, un comando per riga, una riga di risposta per comando
+ * ("OK ..." oppure "ERR <messaggio>"):
+ *   LOAD <nome> <qubits> <file_circ>  parsa e memorizza un insieme di gate
+ *   RUN <file_init> <file_circ>       esegue un job (il circuito viene
+ *                                     messo in cache per percorso, mtime,
+ *                                     dimensione e inode; al più 64 circuiti,
+ *                                     scartando il meno recente)
+ *   RUN <file_init> @<nome>           esegue un job su un insieme caricato
+ *   STATS                             numero di job e latenze p50/p99
+ *   QUIT                              chiude la connessione
+ *   SHUTDOWN                          termina il server
+ *
+ * Input: socket_path (percorso del socket), n_threads (dimensione del pool)
+ * Output: EXIT_SUCCESS alla terminazione, EXIT_FAILURE se il socket non è utilizzabile
+ */
+int server_run(const char *socket_path, size_t n_threads);
+
+#endif
@@ -0,0 +1,143 @@
+#include "sparse_state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* APPLICAZIONE DEI GATE ALLO STATO SPARSO */
+
+static int is_zero(Complex z) {
+    return z.real * z.real + z.imag * z.imag < SPARSE_EPSILON;
+}
+
+/**
+ * Gate locale: ogni ampiezza di indice j contribuisce alle 2^k righe del suo
+ * gruppo (stessi bit fuori dal supporto) con la colonna locale di j.
+ * Output: 0, -1 se out supera SPARSE_MAX_ENTRIES ampiezze
+ */
+static int apply_local(const Gate *g, const SparseVector *in, SparseVector *out) {
+    unsigned int k = g->support_len;
+    size_t kdim = (size_t)1 << k;
+    uint64_t offsets[1 << GATE_LOCAL_MAX_QUBITS];
+    uint64_t mask = 0;
+    for (size_t l = 0; l < kdim; l++) {
+        offsets[l] = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (l & ((size_t)1 << b)) offsets[l] |= (uint64_t)1 << g->support[b];
+    }
+    for (unsigned int b = 0; b < k; b++) mask |= (uint64_t)1 << g->support[b];
+
+    for (size_t i = 0; i < in->capacity; i++) {
+        if (in->keys[i] == SPARSE_EMPTY || is_zero(in->values[i])) continue;
+        uint64_t j = in->keys[i];
+
+        // Elemento locale della colonna: bit del supporto di j
+        size_t l = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (j & ((uint64_t)1 << g->support[b])) l |= (size_t)1 << b;
+
+        uint64_t base = j & ~mask;
+        for (size_t r = 0; r < kdim; r++) {
+            Complex coef = MAT(&g->local, r, l);
+            if (coef.real == 0.0 && coef.imag == 0.0) continue;
+            sparse_vector_add(out, base | offsets[r], complex_mul(coef, in->values[i]));
+        }
+        if (out->count > SPARSE_MAX_ENTRIES) return -1;
+    }
+    return 0;
+}
+
+/**
+ * Gate non locale (o trasformata): ogni ampiezza di indice j contribuisce con
+ * gli elementi non nulli della colonna j della matrice densa.
+ * Output: 0, -1 se out supera SPARSE_MAX_ENTRIES ampiezze
+ */
+static int apply_dense(const Gate *g, const SparseVector *in, SparseVector *out) {
+    const ComplexMatrix *m = &g->matrix;
+    for (size_t i = 0; i < in->capacity; i++) {
+        if (in->keys[i] == SPARSE_EMPTY || is_zero(in->values[i])) continue;
+        uint64_t j = in->keys[i];
+        for (size_t r = 0; r < m->rows; r++) {
+            Complex coef = MAT(m, r, j);
+            if (coef.real == 0.0 && coef.imag == 0.0) continue;
+            sparse_vector_add(out, r, complex_mul(coef, in->values[i]));
+        }
+        if (out->count > SPARSE_MAX_ENTRIES) return -1;
+    }
+    return 0;
+}
+
+/* Copia le ampiezze non nulle dello stato sparso nello stato denso */
+static void write_dense(Circuit *c, const SparseVector *v) {
+    zero_complex_vector(&c->state);
+    for (size_t i = 0; i < v->capacity; i++)
+        if (v->keys[i] != SPARSE_EMPTY) c->state.data[v->keys[i]] = v->values[i];
+}
+
+
+/* ESECUZIONE CON STATO SPARSO */
+
+int circuit_execute_sparse(Circuit *c, ThreadPool *pool) {
+    int dense = c->state.data != NULL;
+    size_t threshold = c->dim / SPARSE_DENSE_RATIO;
+
+    // Stato iniziale: ampiezze non nulle dello stato denso oppure stato sparso
+    SparseVector cur, next;
+    if (dense) {
+        cur = alloc_sparse_vector(1);
+        for (size_t i = 0; i < c->dim && cur.count <= threshold; i++)
+            if (!is_zero(c->state.data[i])) sparse_vector_add(&cur, i, c->state.data[i]);
+    } else {
+        cur = c->sparse;
+        sparse_vector_prune(&cur);
+    }
+    next = alloc_sparse_vector(cur.count);
+
+    size_t s = 0;
+    for (; s < c->sequence_len; s++) {
+        if (dense && cur.count > threshold) break;
+
+        Gate *gate = &c->gates[c->sequence[s]];
+        circuit_analyze_gate(c, c->sequence[s]);
+
+        clear_sparse_vector(&next);
+        int rc = gate->local.data ? apply_local(gate, &cur, &next) : apply_dense(gate, &cur, &next);
+        if (rc != 0) {
+            fprintf(stderr, "Sparse error: gate %zu di %zu (%s) produce più di %zu ampiezze non nulle\n",
+                    s + 1, c->sequence_len, gate->name, SPARSE_MAX_ENTRIES);
+            free_sparse_vector(&next);
+            // Lo stato sparso del circuito resta allocato per circuit_free
+            if (dense) free_sparse_vector(&cur);
+            else c->sparse = cur;
+            return -1;
+        }
+        sparse_vector_prune(&next);
+
+        SparseVector tmp = cur;
+        cur = next;
+        next = tmp;
+    }
+    free_sparse_vector(&next);
+
+    if (!dense) {
+        c->sparse = cur;
+        return 0;
+    }
+
+    // Troppe ampiezze non nulle: il resto della sequenza usa lo stato denso
+    if (s < c->sequence_len) {
+        fprintf(stderr, "Sparse: stato denso dal gate %zu di %zu (%zu ampiezze non nulle)\n",
+                s + 1, c->sequence_len, cur.count);
+        if (s > 0) write_dense(c, &cur);
+        Circuit view = *c;
+        view.sequence = c->sequence + s;
+        view.sequence_len = c->sequence_len - s;
+        circuit_execute_config(&view, pool, 0, KERNEL_LOCAL, NULL);
+        // L'esecuzione scambia i buffer: lo stato aggiornato è quello della vista
+        c->state = view.state;
+    } else {
+        write_dense(c, &cur);
+    }
+    free_sparse_vector(&cur);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef SPARSE_STATE_H
+#define SPARSE_STATE_H
+
+#include "circuit.h"
+
+// Oltre dim / SPARSE_DENSE_RATIO ampiezze non nulle si passa allo stato denso
+#define SPARSE_DENSE_RATIO 8
+
+// Massimo di ampiezze non nulle dello stato sparso (2^24: circa 800 MB per
+// ognuna delle due tabelle hash); oltre l'esecuzione viene interrotta
+#define SPARSE_MAX_ENTRIES ((size_t)1 << 24)
+
+/**
+ * Esegue il circuito memorizzando solo le ampiezze non nulle dello stato
+ * (vedi SparseVector). Ogni gate locale espande solo le ampiezze presenti:
+ * un'ampiezza produce al più 2^k contributi, uno per ogni riga della matrice
+ * locale; i gate non locali usano le colonne della matrice densa. Dopo ogni
+ * gate le ampiezze che si sono annullate vengono rimosse dalla tabella
+ * (sparse_vector_prune), così il conteggio riflette quelle non nulle.
+ *
+ * Se il registro ha uno stato denso (al più CIRCUIT_DENSE_MAX_QUBITS qubit),
+ * lo stato iniziale viene letto da c->state e, quando le ampiezze non nulle
+ * superano dim / SPARSE_DENSE_RATIO, il resto della sequenza viene eseguito
+ * sullo stato denso con circuit_execute_config; al termine il risultato è
+ * sempre in c->state. Altrimenti stato iniziale e finale sono in c->sparse.
+ * Se le ampiezze non nulle superano SPARSE_MAX_ENTRIES l'esecuzione si
+ * interrompe con un errore e lo stato non è più valido.
+ *
+ * La parte sparsa è eseguita nel thread chiamante.
+ * Input: c (circuito con stato iniziale), pool (per la parte densa, NULL = seriale)
+ * Output: 0, -1 se lo stato sparso supera SPARSE_MAX_ENTRIES ampiezze
+ */
+int circuit_execute_sparse(Circuit *c, ThreadPool *pool);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sparse_vector.h"
+
+// Capacità minima della tabella (potenza di 2)
+#define SPARSE_MIN_CAPACITY 16
+
+/* Hash moltiplicativo di Fibonacci: i bit alti del prodotto scelgono lo slot */
+static size_t slot_of(uint64_t key, size_t capacity) {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+static void alloc_table(SparseVector *v, size_t capacity) {
+    v->keys = malloc(capacity * sizeof(uint64_t));
+    v->values = malloc(capacity * sizeof(Complex));
+    if (!v->keys || !v->values) {
+        perror("Errore malloc sparse vector");
+        exit(EXIT_FAILURE);
+    }
+    v->capacity = capacity;
+    v->count = 0;
+    memset(v->keys, 0xFF, capacity * sizeof(uint64_t));
+}
+
+SparseVector alloc_sparse_vector(size_t expected) {
+    SparseVector v;
+    size_t capacity = SPARSE_MIN_CAPACITY;
+    // Fattore di carico massimo 1/2
+    while (capacity < 2 * expected) capacity *= 2;
+    alloc_table(&v, capacity);
+    return v;
+}
+
+void free_sparse_vector(SparseVector *v) {
+    if (v == NULL) return;
+    free(v->keys);
+    free(v->values);
+    v->keys = NULL;
+    v->values = NULL;
+    v->capacity = 0;
+    v->count = 0;
+}
+
+void clear_sparse_vector(SparseVector *v) {
+    if (v == NULL || v->keys == NULL) return;
+    memset(v->keys, 0xFF, v->capacity * sizeof(uint64_t));
+    v->count = 0;
+}
+
+/* Raddoppia la capacità reinserendo tutti gli elementi */
+static void grow(SparseVector *v) {
+    SparseVector old = *v;
+    alloc_table(v, old.capacity ? old.capacity * 2 : SPARSE_MIN_CAPACITY);
+    for (size_t i = 0; i < old.capacity; i++)
+        if (old.keys[i] != SPARSE_EMPTY) sparse_vector_add(v, old.keys[i], old.values[i]);
+    free(old.keys);
+    free(old.values);
+}
+
+void sparse_vector_add(SparseVector *v, uint64_t key, Complex z) {
+    if (2 * (v->count + 1) > v->capacity) grow(v);
+
+    size_t mask = v->capacity - 1;
+    size_t i = slot_of(key, v->capacity);
+    while (v->keys[i] != SPARSE_EMPTY) {
+        if (v->keys[i] == key) {
+            v->values[i] = complex_add(v->values[i], z);
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    v->keys[i] = key;
+    v->values[i] = z;
+    v->count++;
+}
+
+static int is_zero(Complex z) {
+    return z.real * z.real + z.imag * z.imag < SPARSE_EPSILON;
+}
+
+void sparse_vector_prune(SparseVector *v) {
+    size_t live = 0;
+    for (size_t i = 0; i < v->capacity; i++)
+        if (v->keys[i] != SPARSE_EMPTY && !is_zero(v->values[i])) live++;
+    if (live == v->count) return;
+
+    // Con il sondaggio lineare non si possono svuotare slot in mezzo alle catene
+    SparseVector old = *v;
+    *v = alloc_sparse_vector(live);
+    for (size_t i = 0; i < old.capacity; i++)
+        if (old.keys[i] != SPARSE_EMPTY && !is_zero(old.values[i]))
+            sparse_vector_add(v, old.keys[i], old.values[i]);
+    free(old.keys);
+    free(old.values);
+}
+
+void scale_sparse_vector(SparseVector *v, Complex factor) {
+    for (size_t i = 0; i < v->capacity; i++)
+        if (v->keys[i] != SPARSE_EMPTY) v->values[i] = complex_mul(v->values[i], factor);
+}
+
+static int compare_key(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Cerca lo slot dell'indice 'key' (deve essere presente) */
+static size_t find_slot(const SparseVector *v, uint64_t key) {
+    size_t i = slot_of(key, v->capacity);
+    while (v->keys[i] != key) i = (i + 1) & (v->capacity - 1);
+    return i;
+}
+
+void fprint_sparse_vector(FILE *out, const SparseVector *v, unsigned int n_bits) {
+    uint64_t *sorted = malloc((v->count + 1) * sizeof(uint64_t));
+    if (!sorted) {
+        perror("Errore malloc sparse print");
+        exit(EXIT_FAILURE);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < v->capacity; i++)
+        if (v->keys[i] != SPARSE_EMPTY && !is_zero(v->values[i])) sorted[n++] = v->keys[i];
+    qsort(sorted, n, sizeof(uint64_t), compare_key);
+
+    fprintf(out, "[");
+    for (size_t k = 0; k < n; k++) {
+        // Ket con il qubit n-1 a sinistra e il qubit 0 a destra
+        fprintf(out, "|");
+        for (unsigned int b = n_bits; b-- > 0;)
+            fputc((sorted[k] >> b) & 1 ? '1' : '0', out);
+        fprintf(out, ">: ");
+        fprint_complex(out, v->values[find_slot(v, sorted[k])]);
+        if (k + 1 < n)
+            fprintf(out, ", ");
+    }
+    fprintf(out, "]\n");
+    free(sorted);
+}
@@ -0,0 +1,78 @@
+#ifndef SPARSE_VECTOR_H
+#define SPARSE_VECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "complex.h"
+
+// Chiave degli slot liberi: nessun indice della base vale 2^64 - 1 (al più 63 qubit)
+#define SPARSE_EMPTY UINT64_MAX
+
+// Ampiezze con modulo quadro inferiore sono considerate nulle e scartate
+#define SPARSE_EPSILON 1e-24
+
+/**
+ * Vettore sparso di numeri complessi: tabella hash a indirizzamento aperto
+ * (sondaggio lineare) che associa un indice della base alla sua ampiezza.
+ * keys: indici (SPARSE_EMPTY per gli slot liberi)
+ * values: ampiezze corrispondenti
+ * capacity: numero di slot (potenza di 2, 0 se non allocato)
+ * count: numero di slot occupati
+ */
+typedef struct {
+    uint64_t *keys;
+    Complex *values;
+    size_t capacity;
+    size_t count;
+} SparseVector;
+
+/**
+ * Alloca un vettore sparso vuoto con spazio per almeno 'expected' elementi
+ * senza ridimensionamenti.
+ * Input: expected (numero di elementi previsto)
+ * Output: Struttura SparseVector inizializzata
+ */
+SparseVector alloc_sparse_vector(size_t expected);
+
+/**
+ * Libera la memoria occupata dal vettore sparso.
+ * Input: v (puntatore alla struttura da deallocare)
+ */
+void free_sparse_vector(SparseVector *v);
+
+/**
+ * Svuota il vettore mantenendo la capacità allocata.
+ * Input: v (puntatore al vettore)
+ */
+void clear_sparse_vector(SparseVector *v);
+
+/**
+ * Somma z all'ampiezza dell'indice 'key', inserendolo se assente.
+ * La tabella raddoppia quando supera metà della capacità.
+ * Input: v (puntatore al vettore), key (indice della base), z (valore da sommare)
+ */
+void sparse_vector_add(SparseVector *v, uint64_t key, Complex z);
+
+/**
+ * Rimuove le ampiezze nulle (modulo quadro sotto SPARSE_EPSILON), ad esempio
+ * quelle che si cancellano per interferenza; la tabella viene ricostruita
+ * solo se ce n'è almeno una.
+ * Input: v (puntatore al vettore)
+ */
+void sparse_vector_prune(SparseVector *v);
+
+/**
+ * Moltiplica tutte le ampiezze per lo scalare indicato.
+ * Input: v (puntatore al vettore), factor (scalare complesso)
+ */
+void scale_sparse_vector(SparseVector *v, Complex factor);
+
+/**
+ * Stampa gli elementi non nulli (vedi SPARSE_EPSILON) in ordine di indice, come ket di n_bits bit
+ * seguiti dall'ampiezza: [|01>: 0.70711 + i0.00000, ...].
+ * Input: out (FILE*), v (puntatore costante al vettore), n_bits
+ */
+void fprint_sparse_vector(FILE *out, const SparseVector *v, unsigned int n_bits);
+
+#endif
@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+#include "sweep.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE 4096
+#define MAX_COLUMNS 256
+
+
+/* CHECKPOINT DEL PREFISSO */
+
+/**
+ * Stato salvato prima della posizione 'pos' della sequenza.
+ * È valido finché nessun gate in [0, pos) cambia matrice.
+ */
+typedef struct {
+    size_t pos;
+    ComplexVector state;
+    int valid;
+} Checkpoint;
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    if (*s == 0) return s;
+    char *end = s + strlen(s) - 1;
+    while (end > s && isspace((unsigned char)*end)) *end-- = 0;
+    return s;
+}
+
+/* Legge la prossima riga significativa (salta righe vuote e commenti %) */
+static char *next_line(FILE *fp, char *buf, size_t size) {
+    while (fgets(buf, size, fp)) {
+        char *l = trim(buf);
+        if (*l != '\0' && *l != '%') return l;
+    }
+    return NULL;
+}
+
+/**
+ * Applica allo stato del circuito i gate in [from, to) della sequenza,
+ * usando una vista del circuito limitata a quell'intervallo.
+ */
+static void run_segment(Circuit *c, size_t from, size_t to, ThreadPool *pool, ComplexVector *scratch) {
+    if (from >= to) return;
+    Circuit view = *c;
+    view.sequence = c->sequence + from;
+    view.sequence_len = to - from;
+    circuit_execute_pool(&view, pool, scratch);
+    // L'esecuzione scambia i buffer: lo stato aggiornato è quello della vista
+    c->state = view.state;
+}
+
+static void copy_state(ComplexVector *dst, const ComplexVector *src) {
+    memcpy(dst->data, src->data, src->size * sizeof(Complex));
+}
+
+static int compare_size(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+/* ESECUZIONE DELLO SWEEP */
+
+int sweep_run(Circuit *c, const char *sweep_file, ThreadPool *pool) {
+    FILE *fp = fopen(sweep_file, "r");
+    if (!fp) {
+        fprintf(stderr, "Sweep error: cannot open %s\n", sweep_file);
+        return EXIT_FAILURE;
+    }
+
+    // Intestazione: nomi dei parametri, uno per colonna
+    char line[MAX_LINE];
+    char *l = next_line(fp, line, sizeof(line));
+    if (!l) {
+        fprintf(stderr, "Sweep error: missing header\n");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    size_t columns[MAX_COLUMNS];
+    size_t n_cols = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(l, " \t,", &save); tok; tok = strtok_r(NULL, " \t,", &save)) {
+        size_t p = circuit_find_param(c, tok);
+        if (p == c->param_count || n_cols == MAX_COLUMNS) {
+            fprintf(stderr, "Sweep error: unknown parameter %s\n", tok);
+            fclose(fp);
+            return EXIT_FAILURE;
+        }
+        columns[n_cols++] = p;
+    }
+
+    // Prima posizione della sequenza che dipende da ciascun parametro
+    size_t len = c->sequence_len;
+    size_t *first_use = malloc((c->param_count + 1) * sizeof(size_t));
+    if (!first_use) {
+        perror("Errore malloc first_use");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t p = 0; p < c->param_count; p++) first_use[p] = len;
+    for (size_t s = len; s-- > 0;) {
+        for (size_t k = 0; k < c->param_gate_count; k++) {
+            if (c->param_gates[k].gate == c->sequence[s])
+                first_use[c->param_gates[k].param] = s;
+        }
+    }
+
+    // Un checkpoint per ogni posizione distinta di prima occorrenza
+    Checkpoint *cps = malloc((n_cols + 1) * sizeof(Checkpoint));
+    if (!cps) {
+        perror("Errore malloc checkpoints");
+        exit(EXIT_FAILURE);
+    }
+    size_t n_cps = 0;
+    size_t positions[MAX_COLUMNS];
+    for (size_t k = 0; k < n_cols; k++) positions[k] = first_use[columns[k]];
+    qsort(positions, n_cols, sizeof(size_t), compare_size);
+    for (size_t k = 0; k < n_cols; k++) {
+        if (positions[k] == 0 || positions[k] >= len) continue;
+        if (n_cps > 0 && cps[n_cps - 1].pos == positions[k]) continue;
+        cps[n_cps].pos = positions[k];
+        cps[n_cps].state = alloc_complex_vector(c->dim);
+        cps[n_cps].valid = 0;
+        n_cps++;
+    }
+
+    ComplexVector initial = alloc_complex_vector(c->dim);
+    ComplexVector scratch = alloc_complex_vector(c->dim);
+    copy_state(&initial, &c->state);
+
+    int status = EXIT_SUCCESS;
+    int first = 1;
+    size_t points = 0, applied = 0;
+
+    while ((l = next_line(fp, line, sizeof(line)))) {
+        // Lettura dei valori e aggiornamento dei soli gate con parametri cambiati
+        double values[MAX_COLUMNS];
+        size_t n_vals = 0;
+        save = NULL;
+        for (char *tok = strtok_r(l, " \t,", &save); tok && n_vals < MAX_COLUMNS;
+             tok = strtok_r(NULL, " \t,", &save)) {
+            char *end;
+            values[n_vals++] = strtod(tok, &end);
+            if (*end != '\0') n_vals = MAX_COLUMNS;
+        }
+        if (n_vals != n_cols) {
+            fprintf(stderr, "Sweep error: point %zu: expected %zu numeric values\n", points + 1, n_cols);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        size_t start = len;
+        for (size_t k = 0; k < n_cols; k++) {
+            size_t p = columns[k];
+            if (!first && c->param_values[p] == values[k]) continue;
+            circuit_set_param(c, p, values[k]);
+            if (first_use[p] < start) start = first_use[p];
+        }
+        if (first) start = 0;
+
+        // Ripartenza dall'ultimo checkpoint valido che precede il primo gate cambiato
+        if (start < len) {
+            size_t resume = 0;
+            for (size_t k = 0; k < n_cps; k++) {
+                if (cps[k].pos > start) cps[k].valid = 0;
+                else if (cps[k].valid) resume = k + 1;
+            }
+            size_t pos = 0;
+            if (resume > 0) {
+                pos = cps[resume - 1].pos;
+                copy_state(&c->state, &cps[resume - 1].state);
+            } else {
+                copy_state(&c->state, &initial);
+            }
+
+            // Esecuzione a segmenti, salvando lo stato a ogni checkpoint
+            for (size_t k = resume; k < n_cps; k++) {
+                run_segment(c, pos, cps[k].pos, pool, &scratch);
+                copy_state(&cps[k].state, &c->state);
+                cps[k].valid = 1;
+                pos = cps[k].pos;
+            }
+            run_segment(c, pos, len, pool, &scratch);
+            applied += len - (resume > 0 ? cps[resume - 1].pos : 0);
+        }
+        first = 0;
+        points++;
+
+        printf("#");
+        for (size_t k = 0; k < n_cols; k++)
+            printf(" %s=%g", c->params[columns[k]], values[k]);
+        printf("\n");
+        circuit_print_state(c);
+    }
+    fclose(fp);
+
+    if (points > 0)
+        fprintf(stderr, "Sweep: %zu punti, %zu gate applicati su %zu (%.1f%% evitati)\n",
+                points, applied, points * len,
+                len ? 100.0 * (1.0 - (double)applied / (points * len)) : 0.0);
+
+    for (size_t k = 0; k < n_cps; k++) free_complex_vector(&cps[k].state);
+    free(cps);
+    free(first_use);
+    free_complex_vector(&initial);
+    free_complex_vector(&scratch);
+    return status;
+}
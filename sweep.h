@@ -0,0 +1,27 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "circuit.h"
+
+/**
+ * Esegue il circuito per ogni punto di un file di sweep dei parametri.
+ *
+ * Il file contiene una riga di intestazione con i nomi dei parametri e poi
+ * una riga di valori per ogni punto (righe vuote e commenti % ignorati):
+ *     theta phi
+ *     0.1   0.0
+ *     0.2   0.0
+ *
+ * Il circuito viene parsato una sola volta; per ogni punto vengono
+ * ricostruite solo le matrici dei gate che dipendono da parametri cambiati.
+ * Lo stato viene salvato prima della prima occorrenza di ogni parametro
+ * nella sequenza: un punto riparte dal salvataggio che precede il primo gate
+ * modificato, senza ricalcolare il prefisso invariato.
+ * Per ogni punto stampa una riga "# nome=valore ..." seguita dallo stato finale.
+ *
+ * Input: c (circuito con stato iniziale), sweep_file, pool
+ * Output: EXIT_SUCCESS oppure EXIT_FAILURE se il file non è valido
+ */
+int sweep_run(Circuit *c, const char *sweep_file, ThreadPool *pool);
+
+#endif
@@ -0,0 +1,136 @@
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/**
+ * Consuma blocchi di lavoro finché ce ne sono: l'assegnazione avviene con
+ * un contatore atomico, così i worker più veloci prendono più blocchi.
+ */
+static void threadpool_work(ThreadPool *pool, size_t worker) {
+    for (;;) {
+        size_t begin = atomic_fetch_add(&pool->next, pool->chunk);
+        if (begin >= pool->n_items) break;
+
+        size_t end = begin + pool->chunk;
+        if (end > pool->n_items) end = pool->n_items;
+        pool->fn(pool->arg, begin, end, worker);
+    }
+}
+
+/**
+ * Ciclo di vita di un worker in background: attende un nuovo lavoro
+ * (generation incrementata), lo esegue e notifica il completamento.
+ */
+static void *threadpool_worker(void *arg) {
+    ThreadPoolWorker *w = (ThreadPoolWorker *)arg;
+    ThreadPool *pool = w->pool;
+    unsigned long seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->shutdown && pool->generation == seen)
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        threadpool_work(pool, w->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0)
+            pthread_cond_signal(&pool->done_cv);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+void threadpool_init(ThreadPool *pool, size_t n_threads) {
+    if (n_threads == 0) n_threads = 1;
+
+    pool->n_threads = n_threads;
+    pool->generation = 0;
+    pool->active = 0;
+    pool->shutdown = 0;
+    pool->fn = NULL;
+    pool->arg = NULL;
+    pool->n_items = 0;
+    pool->chunk = 1;
+    atomic_init(&pool->next, 0);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+
+    pool->threads = malloc(n_threads * sizeof(pthread_t));
+    pool->workers = malloc(n_threads * sizeof(ThreadPoolWorker));
+    if (!pool->threads || !pool->workers) {
+        perror("Errore malloc thread pool");
+        exit(EXIT_FAILURE);
+    }
+
+    // Il worker 0 è il thread chiamante: si creano solo i restanti
+    for (size_t t = 0; t < n_threads; t++) {
+        pool->workers[t].pool = pool;
+        pool->workers[t].index = t;
+        if (t == 0) continue;
+        if (pthread_create(&pool->threads[t], NULL, threadpool_worker, &pool->workers[t]) != 0) {
+            perror("Errore pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void threadpool_run(ThreadPool *pool, ThreadPoolFn fn, void *arg,
+                    size_t n_items, size_t chunk) {
+    if (n_items == 0) return;
+    if (chunk == 0) chunk = (n_items + pool->n_threads - 1) / pool->n_threads;
+
+    // Caso seriale (o lavoro in un solo blocco): nessun risveglio dei worker
+    if (pool->n_threads == 1 || chunk >= n_items) {
+        fn(arg, 0, n_items, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->n_items = n_items;
+    pool->chunk = chunk;
+    atomic_store(&pool->next, 0);
+    pool->active = pool->n_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Anche il thread chiamante contribuisce al lavoro
+    threadpool_work(pool, 0);
+
+    // Sincronizzazione: attende che tutti i worker abbiano terminato
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void threadpool_free(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t t = 1; t < pool->n_threads; t++)
+        pthread_join(pool->threads[t], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_cond_destroy(&pool->done_cv);
+    free(pool->threads);
+    free(pool->workers);
+    pool->threads = NULL;
+    pool->workers = NULL;
+    pool->n_threads = 0;
+}
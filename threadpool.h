@@ -0,0 +1,71 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/**
+ * Funzione di lavoro eseguita dal pool sul range di elementi [begin, end).
+ * worker: indice del thread che esegue il blocco (0 = thread chiamante),
+ *         utile per accedere a buffer privati preallocati per ciascun worker.
+ */
+typedef void (*ThreadPoolFn)(void *arg, size_t begin, size_t end, size_t worker);
+
+struct ThreadPool;
+
+/**
+ * Descrittore di un worker: puntatore al pool e indice del thread.
+ */
+typedef struct {
+    struct ThreadPool *pool;
+    size_t index;
+} ThreadPoolWorker;
+
+/**
+ * Pool di thread residenti.
+ * I thread vengono creati una sola volta e restano in attesa di lavoro,
+ * evitando il costo di pthread_create/pthread_join per ogni gate.
+ * Il thread chiamante partecipa al lavoro come worker 0, quindi un pool
+ * di dimensione 1 esegue tutto in modo seriale senza sincronizzazione.
+ */
+typedef struct ThreadPool {
+    size_t n_threads;             /* numero totale di worker (chiamante incluso) */
+    pthread_t *threads;           /* thread in background (n_threads - 1) */
+    ThreadPoolWorker *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;       /* segnala un nuovo lavoro disponibile */
+    pthread_cond_t done_cv;       /* segnala la fine del lavoro corrente */
+    unsigned long generation;     /* contatore dei lavori sottomessi */
+    size_t active;                /* worker in background ancora occupati */
+    int shutdown;
+
+    ThreadPoolFn fn;              /* lavoro corrente */
+    void *arg;
+    size_t n_items;
+    size_t chunk;
+    atomic_size_t next;           /* prossimo elemento da assegnare */
+} ThreadPool;
+
+/**
+ * Crea il pool con n_threads worker (minimo 1).
+ * Input: pool, n_threads
+ */
+void threadpool_init(ThreadPool *pool, size_t n_threads);
+
+/**
+ * Esegue fn su [0, n_items) suddividendo il lavoro in blocchi di 'chunk'
+ * elementi assegnati dinamicamente ai worker. Ritorna quando tutti i blocchi
+ * sono completati. chunk = 0 equivale a un blocco per worker.
+ * Non deve essere chiamata da più thread contemporaneamente sullo stesso pool.
+ */
+void threadpool_run(ThreadPool *pool, ThreadPoolFn fn, void *arg,
+                    size_t n_items, size_t chunk);
+
+/**
+ * Termina i worker e libera le risorse del pool.
+ */
+void threadpool_free(ThreadPool *pool);
+
+#endif
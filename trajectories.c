@@ -0,0 +1,353 @@
+#include "trajectories.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* GENERATORE PSEUDO-CASUALE */
+
+/**
+ * xoshiro256**: generatore veloce con stato di 256 bit. Ogni traiettoria
+ * ha il proprio stato, inizializzato con splitmix64 a partire da seed e
+ * indice della traiettoria.
+ */
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void rng_seed(Rng *r, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ splitmix64(&stream);
+    for (int i = 0; i < 4; i++) r->s[i] = splitmix64(&x);
+}
+
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t rng_next(Rng *r) {
+    uint64_t result = rotl(r->s[1] * 5, 7) * 9;
+    uint64_t t = r->s[1] << 17;
+    r->s[2] ^= r->s[0];
+    r->s[3] ^= r->s[1];
+    r->s[1] ^= r->s[2];
+    r->s[0] ^= r->s[3];
+    r->s[2] ^= t;
+    r->s[3] = rotl(r->s[3], 45);
+    return result;
+}
+
+/* Numero uniforme in [0, 1) con 53 bit di precisione */
+static double rng_uniform(Rng *r) {
+    return (rng_next(r) >> 11) * 0x1.0p-53;
+}
+
+
+/* OPERAZIONI SU SINGOLO QUBIT */
+
+/**
+ * Applica in place la matrice 2x2 m = [m0 m1; m2 m3] al qubit q:
+ * ogni coppia di ampiezze (i, i | 2^q) viene trasformata indipendentemente.
+ */
+static void apply_single_qubit(ComplexVector *v, unsigned int q, const Complex m[4]) {
+    size_t bit = (size_t)1 << q;
+    for (size_t i = 0; i < v->size; i++) {
+        if (i & bit) continue;
+        Complex a = v->data[i];
+        Complex b = v->data[i | bit];
+        v->data[i] = complex_add(complex_mul(m[0], a), complex_mul(m[1], b));
+        v->data[i | bit] = complex_add(complex_mul(m[2], a), complex_mul(m[3], b));
+    }
+}
+
+/**
+ * Applica in place il gate locale g: ogni gruppo di 2^k ampiezze con gli
+ * stessi bit fuori dal supporto viene moltiplicato per la matrice locale.
+ */
+static void apply_local(ComplexVector *v, const Gate *g) {
+    unsigned int k = g->support_len;
+    size_t kdim = (size_t)1 << k;
+    size_t offsets[1 << GATE_LOCAL_MAX_QUBITS];
+    size_t mask = 0;
+    for (size_t l = 0; l < kdim; l++) {
+        offsets[l] = 0;
+        for (unsigned int b = 0; b < k; b++)
+            if (l & ((size_t)1 << b)) offsets[l] |= (size_t)1 << g->support[b];
+    }
+    for (unsigned int b = 0; b < k; b++) mask |= (size_t)1 << g->support[b];
+
+    Complex in[1 << GATE_LOCAL_MAX_QUBITS];
+    for (size_t i = 0; i < v->size; i++) {
+        if (i & mask) continue;
+        for (size_t l = 0; l < kdim; l++) in[l] = v->data[i | offsets[l]];
+        for (size_t r = 0; r < kdim; r++) {
+            Complex sum = {0.0, 0.0};
+            for (size_t l = 0; l < kdim; l++)
+                sum = complex_add(sum, complex_mul(MAT(&g->local, r, l), in[l]));
+            v->data[i | offsets[r]] = sum;
+        }
+    }
+}
+
+/* tmp = G v: kernel locale se il gate ne ha la matrice, altrimenti prodotto denso */
+static void apply_gate_into(const Gate *g, const ComplexVector *v, ComplexVector *tmp) {
+    if (g->local.data) {
+        memcpy(tmp->data, v->data, v->size * sizeof(Complex));
+        apply_local(tmp, g);
+    } else {
+        matrix_vector_mul_into(&g->matrix, v, tmp);
+    }
+}
+
+static void scale_vector(ComplexVector *v, double f) {
+    for (size_t i = 0; i < v->size; i++) {
+        v->data[i].real *= f;
+        v->data[i].imag *= f;
+    }
+}
+
+static double norm2(const ComplexVector *v) {
+    double sum = 0.0;
+    for (size_t i = 0; i < v->size; i++)
+        sum += v->data[i].real * v->data[i].real + v->data[i].imag * v->data[i].imag;
+    return sum;
+}
+
+
+/* CANALI DI RUMORE */
+
+/* Canale depolarizzante: con probabilità p un errore X, Y o Z equiprobabile */
+static void noise_depolarizing(ComplexVector *v, unsigned int n_qubits, double p, Rng *rng) {
+    static const Complex paulis[3][4] = {
+        {{0, 0}, {1, 0}, {1, 0}, {0, 0}},      /* X */
+        {{0, 0}, {0, -1}, {0, 1}, {0, 0}},     /* Y */
+        {{1, 0}, {0, 0}, {0, 0}, {-1, 0}}      /* Z */
+    };
+
+    for (unsigned int q = 0; q < n_qubits; q++) {
+        if (rng_uniform(rng) >= p) continue;
+        int k = (int)(rng_uniform(rng) * 3.0);
+        if (k > 2) k = 2;
+        apply_single_qubit(v, q, paulis[k]);
+    }
+}
+
+/**
+ * Amplitude damping con probabilità gamma: l'operatore K1 (decadimento
+ * |1> -> |0>) viene scelto con probabilità gamma * P(qubit = 1), altrimenti K0.
+ * Lo stato viene rinormalizzato dopo l'applicazione.
+ */
+static void noise_damping(ComplexVector *v, unsigned int n_qubits, double gamma, Rng *rng) {
+    for (unsigned int q = 0; q < n_qubits; q++) {
+        size_t bit = (size_t)1 << q;
+        double p_one = 0.0;
+        for (size_t i = 0; i < v->size; i++) {
+            if (i & bit)
+                p_one += v->data[i].real * v->data[i].real + v->data[i].imag * v->data[i].imag;
+        }
+        double p_jump = gamma * p_one;
+
+        if (rng_uniform(rng) < p_jump) {
+            const Complex k1[4] = {{0, 0}, {sqrt(gamma), 0}, {0, 0}, {0, 0}};
+            apply_single_qubit(v, q, k1);
+            scale_vector(v, 1.0 / sqrt(p_jump));
+        } else {
+            const Complex k0[4] = {{1, 0}, {0, 0}, {0, 0}, {sqrt(1.0 - gamma), 0}};
+            apply_single_qubit(v, q, k0);
+            if (p_jump < 1.0) scale_vector(v, 1.0 / sqrt(1.0 - p_jump));
+        }
+    }
+}
+
+/* Sostituisce lo stato con tmp normalizzato (norma al quadrato p) */
+static void take_kraus_result(ComplexVector *v, ComplexVector *tmp, double p) {
+    scale_vector(tmp, 1.0 / sqrt(p));
+    Complex *swap = v->data;
+    v->data = tmp->data;
+    tmp->data = swap;
+}
+
+/**
+ * Canale generico: l'operatore K_k viene scelto con probabilità ||K_k psi||^2.
+ * Gli operatori vengono provati in ordine fino a superare il numero casuale
+ * estratto, così non serve memorizzare tutti i risultati.
+ * Output: il nuovo stato si trova in *v (i buffer possono essere scambiati)
+ */
+static void noise_kraus(const Circuit *c, const NoiseChannel *ch, ComplexVector *v,
+                        ComplexVector *tmp, Rng *rng) {
+    double r = rng_uniform(rng);
+    double cumulative = 0.0;
+    size_t last = ch->kraus_count;
+
+    for (size_t k = 0; k < ch->kraus_count; k++) {
+        apply_gate_into(&c->gates[ch->kraus[k]], v, tmp);
+        double p = norm2(tmp);
+        if (p <= 0.0) continue;
+        cumulative += p;
+        last = k;
+        if (r < cumulative) {
+            take_kraus_result(v, tmp, p);
+            return;
+        }
+    }
+
+    // Errori di arrotondamento (r >= somma delle probabilità): viene scelto
+    // l'ultimo operatore con probabilità non nulla
+    if (last < ch->kraus_count) {
+        apply_gate_into(&c->gates[ch->kraus[last]], v, tmp);
+        take_kraus_result(v, tmp, norm2(tmp));
+    }
+}
+
+
+/* ESECUZIONE PARALLELA DELLE TRAIETTORIE */
+
+// Numero massimo di blocchi di traiettorie, ciascuno con il proprio accumulatore
+#define TRAJECTORY_BLOCKS 256
+// Memoria massima per gli accumulatori dei blocchi
+#define TRAJECTORY_ACC_BYTES ((size_t)64 << 20)
+
+/*
+ * Le traiettorie sono divise in blocchi contigui il cui numero dipende solo
+ * da n_trajectories e dalla dimensione dello stato: ogni blocco somma le
+ * proprie traiettorie in ordine di indice e i blocchi vengono ridotti in
+ * ordine, quindi le somme non dipendono dalla distribuzione tra i thread.
+ */
+typedef struct {
+    const Circuit *c;
+    uint64_t seed;
+    size_t n_trajectories;
+    size_t n_blocks;
+    ComplexVector *state;     /* buffer di stato per worker */
+    ComplexVector *scratch;   /* buffer ausiliario per worker */
+    double **probs;           /* accumulatori delle probabilità per blocco */
+} TrajectoryContext;
+
+static void run_trajectories(void *arg, size_t begin, size_t end, size_t worker) {
+    TrajectoryContext *ctx = (TrajectoryContext *)arg;
+    const Circuit *c = ctx->c;
+    ComplexVector *v = &ctx->state[worker];
+    ComplexVector *tmp = &ctx->scratch[worker];
+
+    for (size_t b = begin; b < end; b++) {
+        double *acc = ctx->probs[b];
+        size_t first = b * ctx->n_trajectories / ctx->n_blocks;
+        size_t last = (b + 1) * ctx->n_trajectories / ctx->n_blocks;
+        for (size_t t = first; t < last; t++) {
+            Rng rng;
+            rng_seed(&rng, ctx->seed, t);
+            memcpy(v->data, c->state.data, c->dim * sizeof(Complex));
+
+            for (size_t s = 0; s < c->sequence_len; s++) {
+                const Gate *g = &c->gates[c->sequence[s]];
+                if (g->transform != TRANSFORM_NONE) {
+                    // Ogni traiettoria è già un'unità di lavoro: trasformata seriale
+                    transform_apply(v, g->transform, g->reverse_in, g->reverse_out, NULL);
+                } else if (g->local.data) {
+                    apply_local(v, g);
+                } else {
+                    matrix_vector_mul_into(&g->matrix, v, tmp);
+                    Complex *swap = v->data;
+                    v->data = tmp->data;
+                    tmp->data = swap;
+                }
+
+                for (size_t n = 0; n < c->noise_count; n++) {
+                    const NoiseChannel *ch = &c->noise[n];
+                    switch (ch->kind) {
+                        case NOISE_DEPOLARIZING: noise_depolarizing(v, c->n_qubits, ch->param, &rng); break;
+                        case NOISE_DAMPING: noise_damping(v, c->n_qubits, ch->param, &rng); break;
+                        case NOISE_KRAUS: noise_kraus(c, ch, v, tmp, &rng); break;
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < c->dim; i++)
+                acc[i] += v->data[i].real * v->data[i].real + v->data[i].imag * v->data[i].imag;
+        }
+    }
+}
+
+void trajectories_run(Circuit *c, ThreadPool *pool, size_t n_trajectories,
+                      uint64_t seed, double *probs) {
+    size_t workers = pool->n_threads;
+
+    // Località dei gate (e degli operatori di Kraus) analizzata una volta sola
+    for (size_t g = 0; g < c->gate_count; g++) circuit_analyze_gate(c, g);
+
+    // Numero di blocchi indipendente dal numero di thread
+    size_t n_blocks = TRAJECTORY_ACC_BYTES / (c->dim * sizeof(double));
+    if (n_blocks > TRAJECTORY_BLOCKS) n_blocks = TRAJECTORY_BLOCKS;
+    if (n_blocks > n_trajectories) n_blocks = n_trajectories;
+    if (n_blocks == 0) n_blocks = 1;
+
+    TrajectoryContext ctx;
+    ctx.c = c;
+    ctx.seed = seed;
+    ctx.n_trajectories = n_trajectories;
+    ctx.n_blocks = n_blocks;
+    ctx.state = malloc(workers * sizeof(ComplexVector));
+    ctx.scratch = malloc(workers * sizeof(ComplexVector));
+    ctx.probs = malloc(n_blocks * sizeof(double *));
+    if (!ctx.state || !ctx.scratch || !ctx.probs) {
+        perror("Errore malloc trajectories");
+        exit(EXIT_FAILURE);
+    }
+
+    // Buffer privati di ogni worker, allocati una sola volta
+    for (size_t w = 0; w < workers; w++) {
+        ctx.state[w] = alloc_complex_vector(c->dim);
+        ctx.scratch[w] = alloc_complex_vector(c->dim);
+    }
+    for (size_t b = 0; b < n_blocks; b++) {
+        ctx.probs[b] = calloc(c->dim, sizeof(double));
+        if (!ctx.probs[b]) {
+            perror("Errore calloc trajectories");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Un blocco alla volta per bilanciare traiettorie di durata diversa
+    threadpool_run(pool, run_trajectories, &ctx, n_blocks, 1);
+
+    // Riduzione degli accumulatori in ordine di blocco e media
+    for (size_t i = 0; i < c->dim; i++) {
+        double sum = 0.0;
+        for (size_t b = 0; b < n_blocks; b++) sum += ctx.probs[b][i];
+        probs[i] = n_trajectories ? sum / n_trajectories : 0.0;
+    }
+
+    for (size_t w = 0; w < workers; w++) {
+        free_complex_vector(&ctx.state[w]);
+        free_complex_vector(&ctx.scratch[w]);
+    }
+    for (size_t b = 0; b < n_blocks; b++)
+        free(ctx.probs[b]);
+    free(ctx.state);
+    free(ctx.scratch);
+    free(ctx.probs);
+}
+
+void trajectories_print(const Circuit *c, const double *probs) {
+    printf("P: [");
+    for (size_t i = 0; i < c->dim; i++)
+        printf("%.5f%s", probs[i], (i + 1 < c->dim) ? ", " : "");
+    printf("]\n");
+
+    // <Z_q> = P(qubit q = 0) - P(qubit q = 1)
+    printf("<Z>: [");
+    for (unsigned int q = 0; q < c->n_qubits; q++) {
+        double z = 0.0;
+        for (size_t i = 0; i < c->dim; i++)
+            z += (i & ((size_t)1 << q)) ? -probs[i] : probs[i];
+        printf("%.5f%s", z, (q + 1 < c->n_qubits) ? ", " : "");
+    }
+    printf("]\n");
+}
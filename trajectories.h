@@ -0,0 +1,39 @@
+#ifndef TRAJECTORIES_H
+#define TRAJECTORIES_H
+
+#include <stdint.h>
+#include "circuit.h"
+
+/* Numero di traiettorie usato se il circuito contiene #noise ma non è indicato */
+#define TRAJECTORIES_DEFAULT 1000
+
+/**
+ * Simulazione rumorosa a traiettorie quantistiche (Monte Carlo).
+ *
+ * Ogni traiettoria parte dallo stato iniziale del circuito, applica la
+ * sequenza di gate e, dopo ogni gate, campiona i canali di rumore (#noise)
+ * mantenendo un vettore di stato normalizzato, senza mai costruire la
+ * matrice densità. I gate (e gli operatori di Kraus) che agiscono su al più
+ * GATE_LOCAL_MAX_QUBITS qubit sono applicati in place con la matrice locale,
+ * gli altri con il prodotto denso. Le traiettorie sono distribuite tra i worker del pool;
+ * ogni worker riusa i propri buffer preallocati e ogni traiettoria ha un
+ * generatore pseudo-casuale indipendente derivato da (seed, indice). Le
+ * probabilità sono sommate per blocchi fissi di traiettorie, ridotti in
+ * ordine: il risultato non dipende dal numero di thread, nemmeno
+ * nell'arrotondamento.
+ *
+ * Input: c (circuito con stato iniziale), pool, n_trajectories, seed,
+ *        probs (array di dim elementi, output)
+ * Output: probs[i] = media sulle traiettorie di |<i|psi>|^2, cioè la
+ *         probabilità di misurare lo stato della base i
+ */
+void trajectories_run(Circuit *c, ThreadPool *pool, size_t n_trajectories,
+                      uint64_t seed, double *probs);
+
+/**
+ * Stampa le probabilità medie e il valore di aspettazione <Z> di ogni qubit.
+ * Input: c (circuito), probs (output di trajectories_run)
+ */
+void trajectories_print(const Circuit *c, const double *probs);
+
+#endif
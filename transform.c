@@ -0,0 +1,234 @@
+#include "transform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Blocchi (in elementi) su cui gli stadi corti vengono eseguiti tutti insieme: 16 KiB
+#define TRANSFORM_BLOCK 1024
+
+
+/* RICONOSCIMENTO */
+
+static size_t bit_reverse(size_t i, unsigned int bits) {
+    size_t r = 0;
+    for (unsigned int b = 0; b < bits; b++) {
+        r = (r << 1) | (i & 1);
+        i >>= 1;
+    }
+    return r;
+}
+
+static unsigned int log2_size(size_t n) {
+    unsigned int bits = 0;
+    while (((size_t)1 << bits) < n) bits++;
+    return bits;
+}
+
+/* H (x) ... (x) H: elemento s * (-1)^{popcount(i & j)} */
+static int matches_wht(const ComplexMatrix *m, double s, double eps) {
+    for (size_t i = 0; i < m->rows; i++) {
+        for (size_t j = 0; j < m->cols; j++) {
+            size_t x = i & j;
+            int odd = 0;
+            while (x) {
+                odd ^= 1;
+                x &= x - 1;
+            }
+            Complex expected = {odd ? -s : s, 0.0};
+            if (!complex_equal(m->data[i * m->cols + j], expected, eps)) return 0;
+        }
+    }
+    return 1;
+}
+
+/* M[i][j] = s * w^{ro(i) ri(j)}, con w le radici dell'unità (coniugate per la IDFT) */
+static int matches_dft(const ComplexMatrix *m, const Complex *roots, double s, int inverse,
+                       int reverse_in, int reverse_out, unsigned int bits, double eps) {
+    size_t n = m->rows;
+    for (size_t i = 0; i < n; i++) {
+        size_t a = reverse_out ? bit_reverse(i, bits) : i;
+        for (size_t j = 0; j < n; j++) {
+            size_t b = reverse_in ? bit_reverse(j, bits) : j;
+            Complex w = roots[(a * b) & (n - 1)];
+            Complex expected = {s * w.real, inverse ? -s * w.imag : s * w.imag};
+            if (!complex_equal(m->data[i * n + j], expected, eps)) return 0;
+        }
+    }
+    return 1;
+}
+
+TransformKind transform_detect(const ComplexMatrix *m, int *reverse_in, int *reverse_out) {
+    *reverse_in = 0;
+    *reverse_out = 0;
+    size_t n = m->rows;
+    if (n < 2 || m->cols != n || (n & (n - 1)) != 0) return TRANSFORM_NONE;
+
+    // Prima riga e prima colonna costanti: comuni a tutte le varianti
+    double s = 1.0 / sqrt((double)n);
+    double eps = TRANSFORM_TOLERANCE * s + TRANSFORM_ROUNDING;
+    Complex first = {s, 0.0};
+    for (size_t j = 0; j < n; j++) {
+        if (!complex_equal(m->data[j], first, eps) ||
+            !complex_equal(m->data[j * n], first, eps))
+            return TRANSFORM_NONE;
+    }
+
+    if (matches_wht(m, s, eps)) return TRANSFORM_WHT;
+
+    Complex *roots = malloc(n * sizeof(Complex));
+    if (!roots) {
+        perror("Errore malloc roots");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t t = 0; t < n; t++) {
+        double angle = 2.0 * M_PI * (double)t / (double)n;
+        roots[t] = (Complex){cos(angle), sin(angle)};
+    }
+
+    unsigned int bits = log2_size(n);
+    TransformKind found = TRANSFORM_NONE;
+    for (int inverse = 0; inverse <= 1 && found == TRANSFORM_NONE; inverse++) {
+        for (int variant = 0; variant < 4; variant++) {
+            int rin = variant & 1, rout = (variant >> 1) & 1;
+            if (matches_dft(m, roots, s, inverse, rin, rout, bits, eps)) {
+                found = inverse ? TRANSFORM_IDFT : TRANSFORM_DFT;
+                *reverse_in = rin;
+                *reverse_out = rout;
+                break;
+            }
+        }
+    }
+
+    free(roots);
+    return found;
+}
+
+const char *transform_name(TransformKind kind) {
+    switch (kind) {
+        case TRANSFORM_DFT: return "DFT";
+        case TRANSFORM_IDFT: return "IDFT";
+        case TRANSFORM_WHT: return "WHT";
+        default: return "none";
+    }
+}
+
+
+/* KERNEL FFT / FWHT */
+
+/**
+ * Dati condivisi dai worker: gli stadi radix-2 sono indicizzati per
+ * butterfly; 'len' è la lunghezza dei blocchi dello stadio corrente.
+ */
+typedef struct {
+    Complex *data;
+    size_t n;
+    unsigned int bits;
+    const Complex *twiddle;   /* n/2 radici dell'unità; NULL per la WHT */
+    size_t len;
+    size_t block;
+    double scale;
+    int reverse;
+} TransformTask;
+
+static void run_items(ThreadPool *pool, ThreadPoolFn fn, void *arg, size_t n_items) {
+    if (pool)
+        threadpool_run(pool, fn, arg, n_items, 0);
+    else
+        fn(arg, 0, n_items, 0);
+}
+
+/* Butterfly [begin, end) dello stadio con blocchi di lunghezza len */
+static void stage_range(const TransformTask *t, size_t len, size_t begin, size_t end) {
+    size_t half = len / 2;
+    size_t step = t->n / len;
+
+    for (size_t b = begin; b < end; b++) {
+        size_t j = b & (half - 1);
+        Complex *x = t->data + ((b - j) << 1) + j;
+        Complex *y = x + half;
+
+        Complex u = *x;
+        Complex v = t->twiddle ? complex_mul(*y, t->twiddle[j * step]) : *y;
+        x->real = u.real + v.real;
+        x->imag = u.imag + v.imag;
+        y->real = u.real - v.real;
+        y->imag = u.imag - v.imag;
+    }
+}
+
+/* Permutazione bit-reversal (se richiesta) e normalizzazione degli indici [begin, end) */
+static void pool_reorder(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const TransformTask *t = (const TransformTask *)arg;
+
+    for (size_t i = begin; i < end; i++) {
+        size_t j = t->reverse ? bit_reverse(i, t->bits) : i;
+        if (j < i) continue;   // coppia già scambiata da i' = j
+        Complex x = t->data[i], y = t->data[j];
+        t->data[i] = (Complex){y.real * t->scale, y.imag * t->scale};
+        if (j != i) t->data[j] = (Complex){x.real * t->scale, x.imag * t->scale};
+    }
+}
+
+/* Tutti gli stadi con len <= block sui blocchi [begin, end) */
+static void pool_local_stages(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const TransformTask *t = (const TransformTask *)arg;
+    size_t per_block = t->block / 2;
+
+    for (size_t blk = begin; blk < end; blk++) {
+        for (size_t len = 2; len <= t->block; len <<= 1)
+            stage_range(t, len, blk * per_block, (blk + 1) * per_block);
+    }
+}
+
+static void pool_global_stage(void *arg, size_t begin, size_t end, size_t worker) {
+    (void)worker;
+    const TransformTask *t = (const TransformTask *)arg;
+    stage_range(t, t->len, begin, end);
+}
+
+void transform_apply(ComplexVector *v, TransformKind kind, int reverse_in, int reverse_out,
+                     ThreadPool *pool) {
+    if (kind == TRANSFORM_NONE) return;
+
+    TransformTask t;
+    t.data = v->data;
+    t.n = v->size;
+    t.bits = log2_size(t.n);
+    t.twiddle = NULL;
+    t.block = t.n < TRANSFORM_BLOCK ? t.n : TRANSFORM_BLOCK;
+
+    Complex *twiddle = NULL;
+    if (kind != TRANSFORM_WHT) {
+        twiddle = malloc((t.n / 2) * sizeof(Complex));
+        if (!twiddle) {
+            perror("Errore malloc twiddle");
+            exit(EXIT_FAILURE);
+        }
+        double sign = kind == TRANSFORM_DFT ? 1.0 : -1.0;
+        for (size_t k = 0; k < t.n / 2; k++) {
+            double angle = 2.0 * M_PI * (double)k / (double)t.n;
+            twiddle[k] = (Complex){cos(angle), sign * sin(angle)};
+        }
+        t.twiddle = twiddle;
+    }
+
+    // La FFT radix-2 (decimazione nel tempo) vuole l'ingresso in ordine
+    // bit-reversed: se la variante lo inverte già, le due permutazioni si annullano
+    t.scale = 1.0 / sqrt((double)t.n);
+    t.reverse = kind != TRANSFORM_WHT && !reverse_in;
+    run_items(pool, pool_reorder, &t, t.n);
+
+    run_items(pool, pool_local_stages, &t, t.n / t.block);
+    for (t.len = 2 * t.block; t.len <= t.n; t.len <<= 1)
+        run_items(pool, pool_global_stage, &t, t.n / 2);
+
+    if (kind != TRANSFORM_WHT && reverse_out) {
+        t.scale = 1.0;
+        t.reverse = 1;
+        run_items(pool, pool_reorder, &t, t.n);
+    }
+
+    free(twiddle);
+}
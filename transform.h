@@ -0,0 +1,54 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "complex_vector.h"
+#include "complex_matrix.h"
+#include "threadpool.h"
+
+// Tolleranza del riconoscimento, relativa al modulo 1/sqrt(N) degli elementi
+#define TRANSFORM_TOLERANCE 1e-4
+// Arrotondamento dei coefficienti nei file di circuito (5 decimali)
+#define TRANSFORM_ROUNDING 5e-6
+
+/*
+ * Trasformate con un kernel veloce O(n 2^n):
+ * - TRANSFORM_DFT  : F[j][k] = e^{+2 pi i jk / N} / sqrt(N) (QFT)
+ * - TRANSFORM_IDFT : la sua inversa, e^{-2 pi i jk / N} / sqrt(N)
+ * - TRANSFORM_WHT  : Walsh-Hadamard, H (x) ... (x) H
+ */
+typedef enum {
+    TRANSFORM_NONE = 0,
+    TRANSFORM_DFT,
+    TRANSFORM_IDFT,
+    TRANSFORM_WHT
+} TransformKind;
+
+/**
+ * Riconosce se la matrice è una delle trasformate. Ogni elemento può scostarsi
+ * dal valore atteso di TRANSFORM_TOLERANCE / sqrt(N) più l'arrotondamento a
+ * 5 decimali: una soglia assoluta fissa accetterebbe, per N grande, matrici
+ * con errori confrontabili con gli elementi stessi.
+ * Per DFT e IDFT sono accettate anche le varianti con ordine dei qubit
+ * invertito in ingresso e/o in uscita (M = P_out F P_in, con P la
+ * permutazione bit-reversal), come la QFT senza gli swap finali.
+ * Input: m (matrice quadrata)
+ * Output: tipo di trasformata; *reverse_in e *reverse_out indicano le permutazioni
+ */
+TransformKind transform_detect(const ComplexMatrix *m, int *reverse_in, int *reverse_out);
+
+/**
+ * Applica in place la trasformata al vettore (lunghezza potenza di 2)
+ * con FFT o FWHT radix-2: gli stadi più corti lavorano su blocchi che stanno
+ * in cache, gli altri vengono divisi tra i thread del pool uno stadio alla volta.
+ * Input: v (vettore), kind, reverse_in, reverse_out (come transform_detect),
+ *        pool (NULL per eseguire nel thread chiamante)
+ */
+void transform_apply(ComplexVector *v, TransformKind kind, int reverse_in, int reverse_out,
+                     ThreadPool *pool);
+
+/**
+ * Nome della trasformata (per i messaggi).
+ */
+const char *transform_name(TransformKind kind);
+
+#endif
@@ -0,0 +1,200 @@
+#include "unitary.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* CACHE DEI SOTTOPRODOTTI */
+
+/**
+ * Nodo dell'albero dei prodotti: intervallo [lo, lo + len) della sequenza.
+ * Nodi con la stessa sottosequenza di gate condividono la stessa voce;
+ * 'count' è il numero di occorrenze nell'albero e il prodotto viene
+ * conservato solo se count > 1.
+ */
+typedef struct {
+    size_t lo;              /* prima occorrenza della sottosequenza */
+    size_t len;
+    uint64_t hash;
+    size_t count;
+    int computed;
+    ComplexMatrix product;
+} ProductEntry;
+
+typedef struct {
+    const Circuit *c;
+    ThreadPool *pool;
+    ProductEntry *entries;  /* tabella a indirizzamento aperto */
+    size_t capacity;
+    size_t multiplications;
+    size_t reused;
+} ProductTree;
+
+/* Hash FNV-1a degli indici dei gate nell'intervallo */
+static uint64_t range_hash(const size_t *seq, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint64_t)seq[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Cerca (o inserisce, se insert != 0) la voce per l'intervallo [lo, lo + len).
+ */
+static ProductEntry *tree_lookup(ProductTree *t, size_t lo, size_t len, int insert) {
+    const size_t *seq = t->c->sequence;
+    uint64_t h = range_hash(seq + lo, len);
+    size_t slot = (size_t)(h % t->capacity);
+
+    for (;;) {
+        ProductEntry *e = &t->entries[slot];
+        if (e->len == 0) {
+            if (!insert) return NULL;
+            e->lo = lo;
+            e->len = len;
+            e->hash = h;
+            return e;
+        }
+        if (e->hash == h && e->len == len &&
+            memcmp(seq + e->lo, seq + lo, len * sizeof(size_t)) == 0)
+            return e;
+        slot = (slot + 1) % t->capacity;
+    }
+}
+
+/* Punto di divisione: la più grande potenza di 2 strettamente minore di len */
+static size_t split_point(size_t len) {
+    size_t p = 1;
+    while (p * 2 < len) p *= 2;
+    return p;
+}
+
+/* Primo passaggio: conta le occorrenze di ogni sottosequenza nell'albero */
+static void tree_count(ProductTree *t, size_t lo, size_t len) {
+    if (len < 2) return;
+    ProductEntry *e = tree_lookup(t, lo, len, 1);
+    // Le sottosequenze già viste non vengono ridiscese: i loro figli sono già contati
+    if (e->count++ > 0) return;
+
+    size_t left = split_point(len);
+    tree_count(t, lo, left);
+    tree_count(t, lo + left, len - left);
+}
+
+
+/* PRODOTTO AD ALBERO */
+
+/**
+ * Prodotto dei gate in [lo, lo + len): G_{lo+len-1} ... G_{lo}.
+ * *owned indica se il chiamante deve liberare la matrice restituita
+ * (le foglie sono le matrici dei gate, i nodi condivisi restano in cache).
+ */
+static ComplexMatrix tree_product(ProductTree *t, size_t lo, size_t len, int *owned) {
+    const Circuit *c = t->c;
+    if (len == 1) {
+        *owned = 0;
+        return c->gates[c->sequence[lo]].matrix;
+    }
+
+    ProductEntry *e = tree_lookup(t, lo, len, 0);
+    if (e && e->computed) {
+        t->reused++;
+        *owned = 0;
+        return e->product;
+    }
+
+    size_t left = split_point(len);
+    int own_l, own_r;
+    ComplexMatrix l = tree_product(t, lo, left, &own_l);
+    ComplexMatrix r = tree_product(t, lo + left, len - left, &own_r);
+
+    // I gate successivi stanno a sinistra nel prodotto
+    ComplexMatrix p = matrix_mul_parallel(&r, &l, t->pool);
+    t->multiplications++;
+    if (own_l) free_complex_matrix(&l);
+    if (own_r) free_complex_matrix(&r);
+
+    if (e && e->count > 1) {
+        e->product = p;
+        e->computed = 1;
+        *owned = 0;
+    } else {
+        *owned = 1;
+    }
+    return p;
+}
+
+ComplexMatrix circuit_unitary(const Circuit *c, ThreadPool *pool) {
+    if (c->sequence_len == 0) {
+        ComplexMatrix id = alloc_complex_matrix(c->dim, c->dim);
+        for (size_t i = 0; i < c->dim; i++) id.data[i * c->dim + i].real = 1.0;
+        return id;
+    }
+
+    ProductTree t;
+    t.c = c;
+    t.pool = pool;
+    t.capacity = 2 * c->sequence_len + 1;
+    t.entries = calloc(t.capacity, sizeof(ProductEntry));
+    t.multiplications = 0;
+    t.reused = 0;
+    if (!t.entries) {
+        perror("Errore calloc product tree");
+        exit(EXIT_FAILURE);
+    }
+
+    tree_count(&t, 0, c->sequence_len);
+
+    int owned;
+    ComplexMatrix u = tree_product(&t, 0, c->sequence_len, &owned);
+    // Il risultato deve appartenere al chiamante anche se è in cache
+    if (!owned) u = copy_complex_matrix(&u);
+
+    fprintf(stderr, "Unitaria: %zu gate, %zu prodotti matriciali, %zu sottoprodotti riusati\n",
+            c->sequence_len, t.multiplications, t.reused);
+
+    for (size_t i = 0; i < t.capacity; i++)
+        if (t.entries[i].computed) free_complex_matrix(&t.entries[i].product);
+    free(t.entries);
+    return u;
+}
+
+
+/* OUTPUT */
+
+/* Elemento nel formato letto da circparser: "a+ib" oppure "a-ib" */
+static void write_element(FILE *out, Complex z) {
+    if (z.imag < 0)
+        fprintf(out, "%.17g-i%.17g", z.real, -z.imag);
+    else
+        fprintf(out, "%.17g+i%.17g", z.real, z.imag);
+}
+
+int unitary_write(const char *path, const ComplexMatrix *u, UnitaryFormat format) {
+    FILE *out = fopen(path, format == UNITARY_BINARY ? "wb" : "w");
+    if (!out) return -1;
+
+    int status = 0;
+    if (format == UNITARY_BINARY) {
+        status = write_complex_matrix_binary(out, u);
+    } else {
+        // File di circuito completo: definizione del gate U e sequenza che lo applica.
+        // Ogni riga della matrice va su una riga del file, a partire dalla seconda.
+        fprintf(out, "#define U [");
+        for (size_t i = 0; i < u->rows; i++) {
+            fprintf(out, "\n (");
+            for (size_t j = 0; j < u->cols; j++) {
+                write_element(out, u->data[i * u->cols + j]);
+                if (j + 1 < u->cols) fprintf(out, ",  ");
+            }
+            fprintf(out, ")");
+        }
+        fprintf(out, " ]\n\n#circ U\n");
+    }
+
+    if (fclose(out) != 0) status = -1;
+    return status;
+}
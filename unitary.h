@@ -0,0 +1,34 @@
+#ifndef UNITARY_H
+#define UNITARY_H
+
+#include "circuit.h"
+
+/* Formati di output della matrice unitaria */
+typedef enum {
+    UNITARY_TEXT,     /* #define U [ ... ] + #circ U, rileggibile dal parser */
+    UNITARY_BINARY    /* formato di write_complex_matrix_binary (#import) */
+} UnitaryFormat;
+
+/**
+ * Calcola l'unitaria complessiva U = G_{L-1} ... G_1 G_0 della sequenza #circ.
+ *
+ * Invece di un prodotto a sinistra gate per gate, la sequenza viene divisa
+ * ricorsivamente in un albero bilanciato: ogni intervallo è spezzato alla
+ * più grande potenza di 2 minore della sua lunghezza, così gli intervalli
+ * sono allineati e una stessa sottosequenza di gate (es. un blocco ripetuto)
+ * produce sempre gli stessi nodi. I sottoprodotti che compaiono più volte
+ * vengono calcolati una sola volta. Ogni prodotto usa matrix_mul_parallel.
+ *
+ * Input: c (circuito), pool (thread pool)
+ * Output: ComplexMatrix dim x dim (identità se la sequenza è vuota)
+ */
+ComplexMatrix circuit_unitary(const Circuit *c, ThreadPool *pool);
+
+/**
+ * Scrive la matrice unitaria su file nel formato richiesto.
+ * Input: path, u (matrice), format
+ * Output: 0 in caso di successo, -1 in caso di errore
+ */
+int unitary_write(const char *path, const ComplexMatrix *u, UnitaryFormat format);
+
+#endif